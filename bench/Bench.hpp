@@ -0,0 +1,88 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+namespace adm::bench
+{
+	// ============================
+	// Measurement
+	//
+	// What one run of a benchmark went through
+	// ============================
+	struct Measurement
+	{
+		// Either can be left at 0 if it doesn't apply
+		size_t bytes{ 0 };
+		size_t items{ 0 };
+		double seconds{ 0.0 };
+	};
+
+	// Runs the function a few times and keeps the fastest run,
+	// the function fills in the bytes and items it went through
+	template<typename Function>
+	Measurement Measure( int iterations, const Function& function )
+	{
+		Measurement best;
+		best.seconds = DBL_MAX;
+
+		for ( int i = 0; i < iterations; i++ )
+		{
+			Measurement current;
+			TimerDouble timer;
+			function( current );
+			current.seconds = timer.GetElapsed( TimeUnits::Seconds );
+
+			if ( current.seconds < best.seconds )
+			{
+				best = current;
+			}
+		}
+
+		return best;
+	}
+
+	// Prints one line of results, in MB/s and millions of items/s
+	void Report( const char* suite, const char* name, const Measurement& measurement );
+
+	// Lexer throughput over generated inputs of roughly "megabytes" each
+	void RunLexerBenchmarks( size_t megabytes, int iterations );
+	// Dictionary reads and writes, "operations" times each
+	void RunDictionaryBenchmarks( size_t operations, int iterations );
+	// FlatMap against std::unordered_map, on small string maps and a large integer one
+	void RunMapBenchmarks( size_t operations, int iterations );
+	// Octree builds and traversals, over "operations" / 4 points
+	void RunNTreeBenchmarks( size_t operations, int iterations );
+
+	// Prints what failed and counts it, for the checks below
+	// @returns The condition
+	bool Expect( bool condition, const char* what, int& failures );
+
+	// Regression checks that ctest runs through --check, see CMakeLists.txt
+	// Each one returns the number of failures
+	// FlatMap against std::unordered_map under random inserts, erases and rehashes,
+	// growing with keys that can only be moved, and probing with strided keys
+	int CheckFlatMap();
+	// Schema and parent dictionaries against plain ones, and parsing good and bad keyvalue blocks
+	int CheckDictionary();
+	// DictionaryArchive round trips, and broken archives being rejected
+	int CheckDictionaryArchive();
+	// Float and int text round trips, and parsing against atof and atoi
+	int CheckNumbers();
+	// Readers against a writer, snapshots must never be half-written or go back in time
+	int CheckConcurrentDictionary();
+	// Octree queries against testing every element, in a shallow and a very deep tree
+	int CheckNTreeQueries();
+	// Parallel rebuilds against a serial one, and TaskPool on its own
+	int CheckNTreeParallel();
+	// RebuildLinear against Rebuild
+	int CheckNTreeLinear();
+
+	// Lexer::Next gluing quotes onto tokens like older versions did
+	int CheckLexerNext();
+
+	// Checks the lexer against the expected tokens of every file in "directory"
+	// If "update" is true, the expected tokens are rewritten instead
+	// @returns The number of files that didn't match
+	int CheckLexerCorpus( const char* directory, bool update );
+}
@@ -0,0 +1,147 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#include "Precompiled.hpp"
+#include "Bench.hpp"
+using namespace adm;
+
+// ============================
+// bench::Report
+// ============================
+void bench::Report( const char* suite, const char* name, const Measurement& measurement )
+{
+	const double seconds = std::max( measurement.seconds, 1e-9 );
+	const double megabytesPerSecond = double( measurement.bytes ) / (1024.0 * 1024.0) / seconds;
+	const double megaitemsPerSecond = double( measurement.items ) / 1e6 / seconds;
+
+	char bytesColumn[32] = "";
+	if ( measurement.bytes > 0U )
+	{
+		snprintf( bytesColumn, sizeof( bytesColumn ), "%10.1f MB/s", megabytesPerSecond );
+	}
+
+	printf( "%-10s %-40s %15s %10.2f M/s %10.2f ms\n",
+		suite, name, bytesColumn, megaitemsPerSecond, measurement.seconds * 1000.0 );
+}
+
+// ============================
+// bench::Expect
+// ============================
+bool bench::Expect( bool condition, const char* what, int& failures )
+{
+	if ( !condition )
+	{
+		printf( "FAILED: %s\n", what );
+		failures++;
+	}
+
+	return condition;
+}
+
+struct NamedCheck
+{
+	const char* name;
+	int ( *function )();
+};
+
+static const NamedCheck Checks[] =
+{
+	{ "LexerNext", bench::CheckLexerNext },
+	{ "FlatMap", bench::CheckFlatMap },
+	{ "Dictionary", bench::CheckDictionary },
+	{ "DictionaryArchive", bench::CheckDictionaryArchive },
+	{ "Numbers", bench::CheckNumbers },
+	{ "ConcurrentDictionary", bench::CheckConcurrentDictionary },
+	{ "NTreeQueries", bench::CheckNTreeQueries },
+	{ "NTreeParallel", bench::CheckNTreeParallel },
+	{ "NTreeLinear", bench::CheckNTreeLinear },
+};
+
+static void PrintUsage()
+{
+	printf( "Usage: AdmUtilsBench [options]\n"
+		"  --size <MB>          Size of each generated input, default is 16\n"
+		"  --operations <N>     Operations per container benchmark, default is 1000000\n"
+		"  --iterations <N>     Runs per benchmark, the fastest one is reported, default is 5\n"
+		"  --corpus <directory> Checks the lexer against a corpus instead of benchmarking\n"
+		"  --update             With --corpus, rewrites the expected tokens\n"
+		"  --check <name>       Runs one of the regression checks instead of benchmarking:\n" );
+
+	for ( const NamedCheck& check : Checks )
+	{
+		printf( "                       %s\n", check.name );
+	}
+}
+
+int main( int argc, char** argv )
+{
+	size_t megabytes = 16U;
+	size_t operations = 1000000U;
+	int iterations = 5;
+	const char* corpusDirectory = nullptr;
+	const char* checkName = nullptr;
+	bool update = false;
+
+	for ( int i = 1; i < argc; i++ )
+	{
+		const StringView argument = argv[i];
+		const bool hasValue = i + 1 < argc;
+
+		if ( argument == "--size" && hasValue )
+		{
+			megabytes = std::max<size_t>( std::strtoul( argv[++i], nullptr, 10 ), 1U );
+		}
+		else if ( argument == "--operations" && hasValue )
+		{
+			operations = std::max<size_t>( std::strtoul( argv[++i], nullptr, 10 ), 1U );
+		}
+		else if ( argument == "--iterations" && hasValue )
+		{
+			iterations = std::max( std::atoi( argv[++i] ), 1 );
+		}
+		else if ( argument == "--corpus" && hasValue )
+		{
+			corpusDirectory = argv[++i];
+		}
+		else if ( argument == "--check" && hasValue )
+		{
+			checkName = argv[++i];
+		}
+		else if ( argument == "--update" )
+		{
+			update = true;
+		}
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	if ( nullptr != corpusDirectory )
+	{
+		return bench::CheckLexerCorpus( corpusDirectory, update ) == 0 ? 0 : 1;
+	}
+
+	if ( nullptr != checkName )
+	{
+		for ( const NamedCheck& check : Checks )
+		{
+			if ( StringView( check.name ) == checkName )
+			{
+				const int failures = check.function();
+				printf( "%s: %i failed\n", check.name, failures );
+				return failures == 0 ? 0 : 1;
+			}
+		}
+
+		PrintUsage();
+		return 1;
+	}
+
+	bench::RunLexerBenchmarks( megabytes, iterations );
+	bench::RunDictionaryBenchmarks( operations, iterations );
+	bench::RunMapBenchmarks( operations, iterations );
+	bench::RunNTreeBenchmarks( operations, iterations );
+	return 0;
+}
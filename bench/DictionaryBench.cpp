@@ -0,0 +1,1020 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#include "Precompiled.hpp"
+#include "Bench.hpp"
+using namespace adm;
+using namespace adm::bench;
+namespace fs = std::filesystem;
+
+// Keeps the compiler from throwing the reads away
+static volatile float FloatSink = 0.0f;
+static volatile size_t SizeSink = 0U;
+
+// A door, with the usual mix of keyvalue types
+static Dictionary MakeEntity()
+{
+	Dictionary dict;
+	dict.SetString( "classname", "func_door" );
+	dict.SetString( "targetname", "door_12" );
+	dict.SetString( "target", "door_12_relay" );
+	dict.SetString( "model", "*12" );
+	dict.SetVec3( "origin", Vec3( 128.0f, -64.0f, 32.5f ) );
+	dict.SetVec3( "angles", Vec3( 0.0f, 90.0f, 0.0f ) );
+	dict.SetFloat( "health", 100.0f );
+	dict.SetFloat( "speed", 250.0f );
+	dict.SetFloat( "wait", 3.0f );
+	dict.SetInteger( "spawnflags", 4 );
+	dict.SetInteger( "lip", 8 );
+	dict.SetBool( "locked", false );
+
+	return dict;
+}
+
+// The same door, as it would be written in a map file
+static String MakeEntityText( size_t entities )
+{
+	String text;
+	for ( size_t i = 0U; i < entities; i++ )
+	{
+		text += "{\n";
+		for ( const auto& [key, value] : MakeEntity() )
+		{
+			text += "\"" + String( key ) + "\" \"" + value.GetString() + "\"\n";
+		}
+		text += "}\n";
+	}
+
+	return text;
+}
+
+// ============================
+// bench::RunDictionaryBenchmarks
+// ============================
+void bench::RunDictionaryBenchmarks( size_t operations, int iterations )
+{
+	printf( "Dictionary: %zu operations, best of %i runs, M/s is operations\n", operations, iterations );
+
+	const Dictionary entity = MakeEntity();
+	const auto report = []( const char* name, const Measurement& measurement )
+	{
+		Report( "Dictionary", name, measurement );
+	};
+
+	// Level load makes lots of these, fills them and throws them away
+	report( "MakeEntity", Measure( iterations, [&]( Measurement& m )
+		{
+			size_t sum = 0U;
+			for ( size_t i = 0U; i < operations; i += 12U )
+			{
+				sum += MakeEntity().GetInteger( "spawnflags" );
+			}
+			SizeSink = sum;
+			m.items = operations;
+		} ) );
+
+	// Spawning instances of a template door, which override two keys
+	report( "Copy, 2 overrides", Measure( iterations, [&]( Measurement& m )
+		{
+			size_t sum = 0U;
+			for ( size_t i = 0U; i < operations; i++ )
+			{
+				Dictionary instance( entity );
+				instance.SetString( "targetname", "door_13" );
+				instance.SetFloat( "health", float( i ) );
+				sum += instance.GetInteger( "spawnflags" );
+			}
+			SizeSink = sum;
+			m.items = operations;
+		} ) );
+
+	const auto doorTemplate = std::make_shared<const Dictionary>( entity );
+	report( "Inherit, 2 overrides", Measure( iterations, [&]( Measurement& m )
+		{
+			size_t sum = 0U;
+			for ( size_t i = 0U; i < operations; i++ )
+			{
+				Dictionary instance( doorTemplate );
+				instance.SetString( "targetname", "door_13" );
+				instance.SetFloat( "health", float( i ) );
+				sum += instance.GetInteger( "spawnflags" );
+			}
+			SizeSink = sum;
+			m.items = operations;
+		} ) );
+
+	// The same door, with its keys in a schema shared by all doors
+	const auto doorSchema = std::make_shared<DictionarySchema>( entity );
+	const Dictionary::Handle doorHealth = doorSchema->Find( "health" );
+	report( "MakeEntity, schema", Measure( iterations, [&]( Measurement& m )
+		{
+			size_t sum = 0U;
+			for ( size_t i = 0U; i < operations; i += 12U )
+			{
+				Dictionary dict( doorSchema );
+				for ( size_t key = 0U; key < 12U; key++ )
+				{
+					dict.SetValue( Dictionary::Handle{ uint32_t( key ) }, entity.GetValue( Dictionary::Handle{ uint32_t( key ) } ) );
+				}
+				sum += dict.GetInteger( "spawnflags" );
+			}
+			SizeSink = sum;
+			m.items = operations;
+		} ) );
+
+	Dictionary door( doorSchema );
+	door.SetFloat( "health", 100.0f );
+	report( "GetFloat, schema", Measure( iterations, [&]( Measurement& m )
+		{
+			float sum = 0.0f;
+			for ( size_t i = 0U; i < operations; i++ )
+			{
+				sum += door.GetFloat( "health" );
+			}
+			FloatSink = sum;
+			m.items = operations;
+		} ) );
+
+	report( "GetValue, schema handle", Measure( iterations, [&]( Measurement& m )
+		{
+			float sum = 0.0f;
+			for ( size_t i = 0U; i < operations; i++ )
+			{
+				sum += door.GetValue( doorHealth ).GetFloat();
+			}
+			FloatSink = sum;
+			m.items = operations;
+		} ) );
+
+	// 12 pairs per entity, so about as many pairs as there are operations
+	const String entityText = MakeEntityText( operations / 12U );
+
+	// What loading entities looked like before ParseAll
+	report( "Next, SetString", Measure( iterations, [&]( Measurement& m )
+		{
+			Lexer lexer( entityText );
+			Vector<Dictionary> pool;
+			while ( lexer.Next( true ) == "{" )
+			{
+				Dictionary& dict = pool.emplace_back();
+				for ( String key = lexer.Next( true ); key != "}" && !key.empty(); key = lexer.Next( true ) )
+				{
+					dict.SetString( key.c_str(), lexer.Next( true ) );
+				}
+			}
+			SizeSink = pool.size();
+			m.bytes = entityText.size();
+			m.items = pool.size() * 12U;
+		} ) );
+
+	report( "ParseAll", Measure( iterations, [&]( Measurement& m )
+		{
+			Lexer lexer( entityText );
+			Vector<Dictionary> pool;
+			Dictionary::ParseAll( lexer, pool );
+			SizeSink = pool.size();
+			m.bytes = entityText.size();
+			m.items = pool.size() * 12U;
+		} ) );
+
+	// Loading the same entities and reading every origin, from text and from an archive
+	Vector<Dictionary> entities;
+	{
+		Lexer lexer( entityText );
+		Dictionary::ParseAll( lexer, entities );
+	}
+
+	report( "ParseAll, GetVec3", Measure( iterations, [&]( Measurement& m )
+		{
+			Lexer lexer( entityText );
+			Vector<Dictionary> pool;
+			Dictionary::ParseAll( lexer, pool );
+			float sum = 0.0f;
+			for ( const Dictionary& dict : pool )
+			{
+				sum += dict.GetVec3( "origin" ).x;
+			}
+			FloatSink = sum;
+			m.bytes = entityText.size();
+			m.items = pool.size();
+		} ) );
+
+	const Vector<uint8_t> archiveBytes = DictionaryArchive::Serialise( entities );
+	report( "Archive, GetVec3", Measure( iterations, [&]( Measurement& m )
+		{
+			const auto archive = DictionaryArchive::FromMemory( archiveBytes.data(), archiveBytes.size() );
+			float sum = 0.0f;
+			for ( size_t i = 0U; i < archive->GetCount(); i++ )
+			{
+				sum += archive->Get( i ).GetVec3( "origin" ).x;
+			}
+			FloatSink = sum;
+			m.bytes = archiveBytes.size();
+			m.items = archive->GetCount();
+		} ) );
+
+	report( "GetFloat", Measure( iterations, [&]( Measurement& m )
+		{
+			float sum = 0.0f;
+			for ( size_t i = 0U; i < operations; i++ )
+			{
+				sum += entity.GetFloat( "health" );
+			}
+			FloatSink = sum;
+			m.items = operations;
+		} ) );
+
+	// Looked up once, read many times
+	report( "Find, GetValue", Measure( iterations, [&]( Measurement& m )
+		{
+			const Dictionary::Handle health = entity.Find( "health" );
+			float sum = 0.0f;
+			for ( size_t i = 0U; i < operations; i++ )
+			{
+				sum += entity.GetValue( health ).GetFloat();
+			}
+			FloatSink = sum;
+			m.items = operations;
+		} ) );
+
+	report( "GetInteger", Measure( iterations, [&]( Measurement& m )
+		{
+			size_t sum = 0U;
+			for ( size_t i = 0U; i < operations; i++ )
+			{
+				sum += entity.GetInteger( "spawnflags" );
+			}
+			SizeSink = sum;
+			m.items = operations;
+		} ) );
+
+	report( "GetVec3", Measure( iterations, [&]( Measurement& m )
+		{
+			float sum = 0.0f;
+			for ( size_t i = 0U; i < operations; i++ )
+			{
+				const Vec3 origin = entity.GetVec3( "origin" );
+				sum += origin.x + origin.y + origin.z;
+			}
+			FloatSink = sum;
+			m.items = operations;
+		} ) );
+
+	report( "GetString", Measure( iterations, [&]( Measurement& m )
+		{
+			size_t sum = 0U;
+			for ( size_t i = 0U; i < operations; i++ )
+			{
+				sum += entity.GetString( "targetname" ).size();
+			}
+			SizeSink = sum;
+			m.items = operations;
+		} ) );
+
+	report( "SetFloat, GetFloat", Measure( iterations, [&]( Measurement& m )
+		{
+			Dictionary dict = entity;
+			float sum = 0.0f;
+			for ( size_t i = 0U; i < operations; i++ )
+			{
+				dict.SetFloat( "speed", float( i ) );
+				sum += dict.GetFloat( "speed" );
+			}
+			FloatSink = sum;
+			m.items = operations;
+		} ) );
+
+	// Text has to be made from scratch every time here
+	report( "SetVec3, GetCString", Measure( iterations, [&]( Measurement& m )
+		{
+			Dictionary dict = entity;
+			size_t sum = 0U;
+			for ( size_t i = 0U; i < operations; i++ )
+			{
+				dict.SetVec3( "origin", Vec3( float( i ), 2.0f, 3.0f ) );
+				sum += std::strlen( dict.GetCString( "origin" ) );
+			}
+			SizeSink = sum;
+			m.items = operations;
+		} ) );
+
+	// Shared config, what readers used to pay for a lock, against a snapshot
+	std::mutex entityMutex;
+	report( "GetFloat, mutex", Measure( iterations, [&]( Measurement& m )
+		{
+			float sum = 0.0f;
+			for ( size_t i = 0U; i < operations; i++ )
+			{
+				std::lock_guard<std::mutex> lock( entityMutex );
+				sum += entity.GetFloat( "health" );
+			}
+			FloatSink = sum;
+			m.items = operations;
+		} ) );
+
+	const ConcurrentDictionary sharedEntity( MakeEntity() );
+	report( "GetFloat, concurrent", Measure( iterations, [&]( Measurement& m )
+		{
+			float sum = 0.0f;
+			for ( size_t i = 0U; i < operations; i++ )
+			{
+				sum += sharedEntity.GetFloat( "health" );
+			}
+			FloatSink = sum;
+			m.items = operations;
+		} ) );
+
+	// Values that came from a text file are parsed on every get
+	report( "GetVec3, GetFloat from text", Measure( iterations, [&]( Measurement& m )
+		{
+			Dictionary dict;
+			dict.SetString( "origin", "128 -64 32.5" );
+			dict.SetString( "health", "100.25" );
+			float sum = 0.0f;
+			for ( size_t i = 0U; i < operations; i++ )
+			{
+				sum += dict.GetVec3( "origin" ).z + dict.GetFloat( "health" );
+			}
+			FloatSink = sum;
+			m.items = operations;
+		} ) );
+}
+
+// ============================
+// Checks
+// ============================
+
+// @returns The keys and values, in iteration order, as key=value lines
+static String DumpPairs( const Dictionary& dict )
+{
+	String dump;
+	for ( const auto& [key, value] : dict )
+	{
+		dump += String( key ) + "=" + value.GetString() + "\n";
+	}
+
+	return dump;
+}
+
+// ============================
+// bench::CheckDictionary
+// ============================
+int bench::CheckDictionary()
+{
+	int failures = 0;
+
+	// A schema dictionary has to act like a plain one with the same keys set
+	auto schema = std::make_shared<DictionarySchema>( std::initializer_list<StringView>{ "health", "origin", "speed" } );
+	const Dictionary::Handle health = schema->Find( "health" );
+	const Dictionary::Handle speed = schema->Find( "speed" );
+
+	Dictionary dict( schema );
+	Expect( !dict.KeyExists( "health" ), "schema: unset keys don't exist", failures );
+	Expect( dict.GetFloat( "health", 42.0f ) == 42.0f, "schema: unset keys give the default", failures );
+	float out = 0.0f;
+	Expect( !dict.GetFloat( "health", out ), "schema: unset keys can't be read", failures );
+	Expect( dict.GetNumKeys() == 0U, "schema: no keys until they are set", failures );
+	Expect( dict.begin() == dict.end(), "schema: nothing to iterate until keys are set", failures );
+	Expect( dict.GetValue( health ).GetString().empty(), "schema: unset handles give an empty value", failures );
+
+	dict.SetValue( speed, 250.0f );
+	dict.SetString( "classname", "func_door" );
+	dict.SetFloat( "health", 100.0f );
+
+	Dictionary plain;
+	plain.SetFloat( "health", 100.0f );
+	plain.SetFloat( "speed", 250.0f );
+	plain.SetString( "classname", "func_door" );
+
+	Expect( dict.KeyExists( "health" ) && dict.KeyExists( "speed" ) && !dict.KeyExists( "origin" ), "schema: set keys exist", failures );
+	Expect( dict.GetNumKeys() == plain.GetNumKeys(), "schema: same number of keys as a plain dictionary", failures );
+	Expect( DumpPairs( dict ) == DumpPairs( plain ), "schema: iterates like a plain dictionary", failures );
+
+	// Same thing, from an archive's point of view
+	const Vector<uint8_t> schemaArchive = DictionaryArchive::Serialise( { dict } );
+	const Vector<uint8_t> plainArchive = DictionaryArchive::Serialise( { plain } );
+	Expect( schemaArchive == plainArchive, "schema: archived like a plain dictionary", failures );
+
+	// Children of a schema dictionary see only what is set, until they set more
+	auto parent = std::make_shared<const Dictionary>( dict );
+	Dictionary child( parent );
+	Expect( !child.KeyExists( "origin" ) && child.GetNumKeys() == 3U, "schema: children inherit only set keys", failures );
+	child.SetVec3( "origin", Vec3( 1.0f, 2.0f, 3.0f ) );
+	child.SetFloat( "health", 50.0f );
+	Expect( child.KeyExists( "origin" ) && child.GetNumKeys() == 4U, "schema: children can set their parent's unset keys", failures );
+	Expect( DumpPairs( child ) == "health=50\norigin=1 2 3\nspeed=250\nclassname=func_door\n", "schema: children iterate in handle order", failures );
+	Expect( !parent->KeyExists( "origin" ), "schema: children don't change their parent", failures );
+
+	// Copies keep which keys are set
+	Dictionary copy( dict );
+	Expect( DumpPairs( copy ) == DumpPairs( dict ) && !copy.KeyExists( "origin" ), "schema: copies keep unset keys unset", failures );
+
+	// Values don't move as keys are added, enough of them to go past
+	// the inline pairs and grow the index a couple of times
+	Dictionary growing;
+	growing.SetString( "classname", "light" );
+	growing.SetInteger( "short", 5 );
+	const char* classname = growing.GetCString( "classname" );
+	const String& shortText = growing.GetValue( growing.Find( "short" ) ).GetString();
+	for ( int i = 0; i < 200; i++ )
+	{
+		growing.SetInteger( "key" + std::to_string( i ), i );
+	}
+	Expect( classname == growing.GetCString( "classname" ) && StringView( classname ) == "light", "stable: C strings survive adding keys", failures );
+	Expect( &shortText == &growing.GetValue( growing.Find( "short" ) ).GetString() && shortText == "5", "stable: short strings survive adding keys", failures );
+
+	Dictionary moved( std::move( growing ) );
+	Expect( classname == moved.GetCString( "classname" ), "stable: C strings survive moving the dictionary", failures );
+
+	// Same for overrides of a parent's keys
+	Dictionary instance( parent );
+	instance.SetString( "classname", "func_button" );
+	const char* overridden = instance.GetCString( "classname" );
+	instance.SetFloat( "health", 1.0f );
+	instance.SetVec3( "origin", Vec3( 4.0f, 5.0f, 6.0f ) );
+	instance.SetFloat( "speed", 2.0f );
+	for ( int i = 0; i < 40; i++ )
+	{
+		instance.SetInteger( "key" + std::to_string( i ), i );
+	}
+	Expect( overridden == instance.GetCString( "classname" ) && StringView( overridden ) == "func_button", "stable: overrides survive adding keys", failures );
+
+	// Moved-from dictionaries are left empty, parent and schema included
+	const String instancePairs = DumpPairs( instance );
+	Dictionary target( std::move( instance ) );
+	Expect( DumpPairs( target ) == instancePairs, "move: everything is carried over", failures );
+	Expect( instance.GetNumKeys() == 0U && DumpPairs( instance ).empty() && !instance.KeyExists( "health" ), "move: moved-from dictionaries are empty", failures );
+	Expect( nullptr == instance.GetParent() && nullptr == instance.GetSchema(), "move: moved-from dictionaries have no parent or schema", failures );
+
+	Dictionary assigned( parent );
+	assigned = std::move( target );
+	Expect( DumpPairs( assigned ) == instancePairs, "move: everything is carried over by assignment", failures );
+	Expect( target.GetNumKeys() == 0U && DumpPairs( target ).empty(), "move: moved-from dictionaries are empty after assignment", failures );
+
+	// And can be used again
+	instance.SetString( "classname", "info_target" );
+	Expect( DumpPairs( instance ) == "classname=info_target\n", "move: moved-from dictionaries can be reused", failures );
+
+	Dictionary copied;
+	copied = assigned;
+	Expect( DumpPairs( copied ) == instancePairs && DumpPairs( assigned ) == instancePairs, "copy: assignment copies everything", failures );
+
+	// Keyvalue blocks, braces in quotes are just text
+	Lexer blocks( "{ \"classname\" \"light\" origin \"1 2 3\" } { \"message\" \"{ hi }\" }" );
+	Vector<Dictionary> parsed;
+	Expect( Dictionary::ParseAll( blocks, parsed ) == 2U && DumpPairs( parsed[0] ) == "classname=light\norigin=1 2 3\n"
+		&& DumpPairs( parsed[1] ) == "message={ hi }\n", "parse: blocks are parsed into pairs", failures );
+
+	// Delimiters where keys and values go would be stored as text and throw
+	// the rest out of step with the blocks, the pairs before them are kept
+	struct ParseCase
+	{
+		const char* text;
+		const char* pairsBefore;
+	};
+
+	static constexpr ParseCase Malformed[] =
+	{
+		{ "{ \"a\" { \"b\" \"c\" } }", "" },
+		{ "{ \"a\" \"1\" { \"b\" \"c\" } }", "a=1\n" },
+		{ "{ \"a\" \"1\" ; \"b\" \"2\" }", "a=1\n" },
+		{ "{ \"a\" : \"1\" }", "" },
+		{ "{ \"a\" ( \"1\" ) }", "" },
+		{ "{ \"a\" }", "" },
+		{ "{ \"a\" \"1\"", "a=1\n" },
+		{ "\"a\" \"1\"", "" },
+		{ "}", "" },
+	};
+
+	for ( const ParseCase& parseCase : Malformed )
+	{
+		Lexer lexer( parseCase.text );
+		Dictionary malformed;
+		Expect( !malformed.ParseFrom( lexer ), parseCase.text, failures );
+		Expect( DumpPairs( malformed ) == parseCase.pairsBefore, "parse: pairs before the error are kept", failures );
+	}
+
+	// ParseAll stops at the first bad block
+	Lexer nested( "{ \"a\" \"1\" } { \"b\" { \"c\" \"2\" } } { \"d\" \"3\" }" );
+	parsed.clear();
+	Expect( Dictionary::ParseAll( nested, parsed ) == 1U && DumpPairs( parsed[0] ) == "a=1\n", "parse: ParseAll stops at nested blocks", failures );
+
+	return failures;
+}
+
+// A handful of dictionaries with every value type, shared strings and an empty one
+static Vector<Dictionary> MakeArchiveDictionaries()
+{
+	Vector<Dictionary> dictionaries;
+	for ( int i = 0; i < 20; i++ )
+	{
+		Dictionary& dict = dictionaries.emplace_back( MakeEntity() );
+		dict.SetString( "targetname", "door_" + std::to_string( i ) );
+		dict.SetFloat( "speed", 100.0f + float( i ) * 0.5f );
+		dict.SetString( "message", i % 2 == 0 ? "Locked" : "" );
+		dict.SetString( "origin text", "1 2 3" );
+	}
+
+	dictionaries.emplace_back();
+
+	// Enough keys to need a few rounds of probing
+	Dictionary& big = dictionaries.emplace_back();
+	for ( int i = 0; i < 200; i++ )
+	{
+		big.SetInteger( "key" + std::to_string( i ), i * 7 );
+	}
+
+	return dictionaries;
+}
+
+// sizeof( ArchiveHeader ), see DictionaryArchive.cpp
+constexpr size_t ArchiveHeaderSize = 36U;
+
+// Reads every key and value of a possibly broken archive, the sanitisers
+// catch it going out of bounds, and the sums keep it from being optimised out
+static void ReadEverything( const DictionaryArchive& archive )
+{
+	size_t sum = 0U;
+	for ( size_t i = 0U; i < archive.GetCount(); i++ )
+	{
+		const DictionaryView view = archive.Get( i );
+		for ( size_t k = 0U; k < view.GetNumKeys(); k++ )
+		{
+			const StringView key = view.GetKey( k );
+			sum += key.size() + view.GetString( key ).size() + strlen( view.GetCString( key ) );
+			sum += size_t( view.GetInteger( key ) ) + (view.KeyExists( key ) ? 1U : 0U);
+		}
+		sum += view.ToDictionary().GetNumKeys() + (view.KeyExists( "origin" ) ? 1U : 0U);
+	}
+	SizeSink = sum;
+}
+
+static bool SameAsArchived( const Dictionary& dict, const DictionaryView& view )
+{
+	if ( view.GetNumKeys() != dict.GetNumKeys() || view.KeyExists( "not a key" ) )
+	{
+		return false;
+	}
+
+	size_t index = 0U;
+	for ( const auto& [key, value] : dict )
+	{
+		const Vec3 vector = view.GetVec3( key );
+		const Vec3 expectedVector = value.GetVec3();
+		if ( view.GetKey( index++ ) != key || !view.KeyExists( key )
+			|| view.GetString( key ) != value.GetString() || StringView( view.GetCString( key ) ) != value.GetString()
+			|| view.GetFloat( key ) != value.GetFloat() || view.GetInteger( key ) != value.GetInteger()
+			|| view.GetBool( key ) != value.GetBool()
+			|| vector.x != expectedVector.x || vector.y != expectedVector.y || vector.z != expectedVector.z )
+		{
+			return false;
+		}
+	}
+
+	return view.GetFloat( "not a key", 42.0f ) == 42.0f && DumpPairs( view.ToDictionary() ) == DumpPairs( dict );
+}
+
+// ============================
+// bench::CheckDictionaryArchive
+// ============================
+int bench::CheckDictionaryArchive()
+{
+	int failures = 0;
+
+	const Vector<Dictionary> dictionaries = MakeArchiveDictionaries();
+	const Vector<uint8_t> bytes = DictionaryArchive::Serialise( dictionaries );
+
+	// Written out and memory-mapped back in, every key has to be found
+	const String path = (fs::temp_directory_path() / "AdmUtilsCheck.ents").string();
+	Expect( DictionaryArchive::Write( path, dictionaries ), "archive: written to a file", failures );
+	{
+		const auto archive = DictionaryArchive::FromFile( path );
+		if ( Expect( archive.has_value() && archive->GetCount() == dictionaries.size(), "archive: mapped from a file", failures ) )
+		{
+			for ( size_t i = 0U; i < dictionaries.size(); i++ )
+			{
+				Expect( SameAsArchived( dictionaries[i], archive->Get( i ) ), "archive: same keys and values as the dictionary", failures );
+			}
+
+			Expect( archive->Get( dictionaries.size() ).GetNumKeys() == 0U, "archive: out of range gives an empty view", failures );
+			Expect( archive->Verify(), "archive: the file verifies", failures );
+		}
+	}
+
+	// A file that was cut short
+	{
+		std::ofstream file( path, std::ios::binary | std::ios::trunc );
+		file.write( reinterpret_cast<const char*>( bytes.data() ), std::streamsize( bytes.size() / 2U ) );
+	}
+	Expect( !DictionaryArchive::FromFile( path ).has_value(), "archive: truncated file is rejected", failures );
+	fs::remove( path );
+
+	// Broken copies go into buffers of their exact size, so reading past
+	// the end would be caught by the sanitisers, and must be rejected
+	Vector<uint32_t> buffer( bytes.size() / sizeof( uint32_t ) + 1U );
+	uint8_t* copy = reinterpret_cast<uint8_t*>( buffer.data() );
+
+	int numAccepted = 0;
+	for ( size_t size = 0U; size < bytes.size(); size++ )
+	{
+		std::memcpy( copy, bytes.data(), size );
+		numAccepted += DictionaryArchive::FromMemory( copy, size ).has_value() ? 1 : 0;
+	}
+	Expect( numAccepted == 0, "archive: every truncation is rejected", failures );
+
+	// Flipped bits in the header are caught on load, the rest by Verify,
+	// archives that load anyway must still be safe to read
+	numAccepted = 0;
+	int numVerified = 0;
+	std::memcpy( copy, bytes.data(), bytes.size() );
+	for ( size_t bit = 0U; bit < bytes.size() * 8U; bit++ )
+	{
+		copy[bit / 8U] ^= uint8_t( 1U << (bit % 8U) );
+		const auto archive = DictionaryArchive::FromMemory( copy, bytes.size() );
+		if ( archive )
+		{
+			numAccepted += bit < ArchiveHeaderSize * 8U ? 1 : 0;
+			numVerified += archive->Verify() ? 1 : 0;
+
+			// Reading all of it every time takes too long
+			if ( bit % 67U == 0U )
+			{
+				ReadEverything( *archive );
+			}
+		}
+		copy[bit / 8U] ^= uint8_t( 1U << (bit % 8U) );
+	}
+	Expect( numAccepted == 0, "archive: every flipped bit in the header is rejected", failures );
+	Expect( numVerified == 0, "archive: every flipped bit fails verification", failures );
+	const auto unbroken = DictionaryArchive::FromMemory( copy, bytes.size() );
+	Expect( unbroken.has_value() && unbroken->Verify(), "archive: the unbroken copy is accepted", failures );
+
+	// Random garbage with a valid-looking start
+	uint32_t seed = 777U;
+	numAccepted = 0;
+	for ( int attempt = 0; attempt < 1000; attempt++ )
+	{
+		std::memcpy( copy, bytes.data(), 8U );
+		for ( size_t i = 8U; i < bytes.size(); i++ )
+		{
+			seed = seed * 1664525U + 1013904223U;
+			copy[i] = uint8_t( seed >> 24U );
+		}
+		numAccepted += DictionaryArchive::FromMemory( copy, bytes.size() ).has_value() ? 1 : 0;
+	}
+	Expect( numAccepted == 0, "archive: garbage is rejected", failures );
+
+	// Garbage behind a valid header loads, but doesn't verify
+	numAccepted = 0;
+	numVerified = 0;
+	for ( int attempt = 0; attempt < 1000; attempt++ )
+	{
+		std::memcpy( copy, bytes.data(), ArchiveHeaderSize );
+		for ( size_t i = ArchiveHeaderSize; i < bytes.size(); i++ )
+		{
+			seed = seed * 1664525U + 1013904223U;
+			copy[i] = uint8_t( seed >> 24U );
+		}
+
+		const auto archive = DictionaryArchive::FromMemory( copy, bytes.size() );
+		if ( archive )
+		{
+			numAccepted++;
+			numVerified += archive->Verify() ? 1 : 0;
+			ReadEverything( *archive );
+		}
+	}
+	Expect( numAccepted == 1000 && numVerified == 0, "archive: garbage after the header fails verification", failures );
+
+	// Misaligned memory can't be read in place
+	std::memcpy( copy + 1U, bytes.data(), bytes.size() - 1U );
+	Expect( !DictionaryArchive::FromMemory( copy + 1U, bytes.size() - 1U ).has_value(), "archive: misaligned memory is rejected", failures );
+
+	return failures;
+}
+
+// Same bits, or both NaN
+static bool SameFloat( float a, float b )
+{
+	return (std::isnan( a ) && std::isnan( b )) || std::memcmp( &a, &b, sizeof( float ) ) == 0;
+}
+
+// What Dictionary::GetFloat used to do, with atof's double turned into
+// infinity explicitly where it rounds past FLT_MAX, half an ulp above it
+static float OldParseFloat( const char* text )
+{
+	const double value = std::atof( text );
+	const double limit = double( FLT_MAX ) + std::ldexp( 1.0, FLT_MAX_EXP - FLT_MANT_DIG - 1 );
+	return std::abs( value ) >= limit ? std::copysign( INFINITY, float( value ) ) : float( value );
+}
+
+// ============================
+// bench::CheckNumbers
+// ============================
+int bench::CheckNumbers()
+{
+	int failures = 0;
+	char buffer[Vec4TextSize];
+
+	// Every float has to come back exactly as it was written, going
+	// through a good spread of bit patterns and the special values
+	Vector<float> floats = { 0.0f, -0.0f, FLT_MIN, -FLT_MIN, FLT_MAX, -FLT_MAX, FLT_TRUE_MIN, -FLT_TRUE_MIN,
+		FLT_EPSILON, INFINITY, -INFINITY, NAN, 0.1f, 1.0f / 3.0f, 100.0f, 16777217.0f, -1.1754942e-38f };
+	for ( uint64_t bits = 0U; bits <= UINT32_MAX; bits += 997U )
+	{
+		const uint32_t bits32 = uint32_t( bits );
+		float value;
+		std::memcpy( &value, &bits32, sizeof( float ) );
+		floats.push_back( value );
+	}
+
+	int numMismatches = 0;
+	int numTooLong = 0;
+	for ( const float value : floats )
+	{
+		const size_t length = WriteFloat( value, buffer, FloatTextSize );
+		numTooLong += length == 0U ? 1 : 0;
+		numMismatches += SameFloat( ParseFloat( StringView( buffer, length ) ), value ) ? 0 : 1;
+	}
+	Expect( numTooLong == 0, "numbers: every float fits in FloatTextSize", failures );
+	Expect( numMismatches == 0, "numbers: float to text to float gives the same bits", failures );
+
+	numMismatches = 0;
+	for ( size_t i = 0U; i + 4U <= floats.size(); i += 4U )
+	{
+		float values[4]{};
+		const size_t length = WriteFloats( &floats[i], 4U, buffer, Vec4TextSize );
+		const size_t count = ParseFloats( StringView( buffer, length ), values, 4U );
+		numMismatches += count == 4U && SameFloat( values[0], floats[i] ) && SameFloat( values[1], floats[i + 1U] )
+			&& SameFloat( values[2], floats[i + 2U] ) && SameFloat( values[3], floats[i + 3U] ) ? 0 : 1;
+	}
+	Expect( numMismatches == 0, "numbers: vectors to text and back give the same bits", failures );
+
+	for ( const int value : { 0, 1, -1, 7531, INT_MAX, INT_MIN } )
+	{
+		const size_t length = WriteInteger( value, buffer, IntegerTextSize );
+		Expect( ParseInteger( StringView( buffer, length ) ) == value, "numbers: int to text to int gives the same value", failures );
+	}
+
+	// Parsing has to give what atof and atoi did, leniency included
+	const char* texts[] =
+	{
+		"", " ", "abc", "-", "+", "+-1", "-+1", "--1", "++1", ".", "e5", "1e", "1e+", "1e-x", "5.", ".5", "-.5e1",
+		"1.5abc", "12 34", "1,5", "  \t\n\v\f\r-3.25", "+2", "+.5", "+inf", "inf", "-inf", "INF", "Infinity", "infinit",
+		"nan", "-nan", "NAN", "nan(123)", "nanx", "0x10", "-0x1.8p1", "0X1P-2", "0x", "0xg", "0x.", "0x.8", "+0x1p4",
+		"1e38", "3.4028235e38", "3.4028236e38", "1e39", "-1e50", "1e400", "1e-40", "1e-45", "1e-46", "-1e-50", "1e-400",
+		"0.000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000001",
+		"100000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000"
+		"00000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000"
+		"00000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000",
+		"0x1p200", "-0x1p-200", "0x1p99999", "0x1p-99999", "1e99999", "-1e-99999", "2147483647", "-2147483648",
+		"2147483648", "-2147483649", "99999999999999999999", "-99999999999999999999", "1.9", "-1.9", "007", "+-0"
+	};
+
+	for ( const char* text : texts )
+	{
+		const String what = String( "numbers: parses \"" ) + text + "\" like atof and atoi";
+		Expect( SameFloat( ParseFloat( text ), OldParseFloat( text ) ), what.c_str(), failures );
+
+		// Out of int's range, atoi is undefined, strtol clamps and so does ParseInteger
+		const long wide = std::strtol( text, nullptr, 10 );
+		Expect( ParseInteger( text ) == int( std::clamp<long>( wide, INT_MIN, INT_MAX ) ), what.c_str(), failures );
+
+		// ParseFloats reads one number the same way, unless there isn't one
+		float value = 42.0f;
+		const size_t count = ParseFloats( text, &value, 1U );
+		Expect( count == 1U ? SameFloat( value, OldParseFloat( text ) ) : value == 42.0f && OldParseFloat( text ) == 0.0f,
+			what.c_str(), failures );
+	}
+
+	// Random numbers with the odd sign, exponent and trailing garbage
+	uint32_t seed = 4242U;
+	const auto random = [&seed]( uint32_t range )
+	{
+		seed = seed * 1664525U + 1013904223U;
+		return (seed >> 8U) % range;
+	};
+
+	numMismatches = 0;
+	for ( int attempt = 0; attempt < 100000; attempt++ )
+	{
+		String text = String( random( 3U ), ' ' ) + "  +-"[random( 4U )];
+		for ( uint32_t digit = random( 10U ); digit > 0U; digit-- )
+		{
+			text += char( '0' + random( 10U ) );
+		}
+		if ( random( 2U ) )
+		{
+			text += '.';
+			for ( uint32_t digit = random( 6U ); digit > 0U; digit-- )
+			{
+				text += char( '0' + random( 10U ) );
+			}
+		}
+		if ( random( 2U ) )
+		{
+			text += "eE"[random( 2U )] + std::to_string( int( random( 100U ) ) - 50 );
+		}
+		text += " x,1"[random( 4U )];
+
+		numMismatches += SameFloat( ParseFloat( text ), OldParseFloat( text.c_str() ) ) ? 0 : 1;
+	}
+	Expect( numMismatches == 0, "numbers: random text parses like atof", failures );
+
+	// Vectors are separated by whitespace or commas, and stop at the first thing that isn't a number
+	float values[3] = { 7.0f, 7.0f, 7.0f };
+	Expect( ParseFloats( " 1, +2 ,-3x", values, 3U ) == 3U && values[0] == 1.0f && values[1] == 2.0f && values[2] == -3.0f,
+		"numbers: vectors with commas", failures );
+	values[2] = 7.0f;
+	Expect( ParseFloats( "4 5 abc", values, 3U ) == 2U && values[0] == 4.0f && values[1] == 5.0f && values[2] == 7.0f,
+		"numbers: vectors cut short keep the rest", failures );
+	Expect( ParseFloats( "1,,2", values, 3U ) == 1U, "numbers: an empty component stops parsing", failures );
+
+	// And the same through Dictionary, which used atof and atoi directly
+	Dictionary dict;
+	dict.SetString( "speed", " +250.5units" );
+	dict.SetString( "count", "12abc" );
+	dict.SetString( "origin", "1 2.5 -3e2" );
+	Expect( dict.GetFloat( "speed" ) == 250.5f && dict.GetInteger( "count" ) == 12, "numbers: dictionary text parses like atof", failures );
+	Expect( dict.GetVec3( "origin" ) == Vec3( 1.0f, 2.5f, -300.0f ), "numbers: dictionary vectors", failures );
+
+	return failures;
+}
+
+// ============================
+// bench::CheckConcurrentDictionary
+// ============================
+int bench::CheckConcurrentDictionary()
+{
+	int failures = 0;
+
+	// Write number N sets every key to N in one go, so a snapshot
+	// with keys from different writes was published half-done
+	constexpr int NumWrites = 2000;
+	constexpr size_t NumReaders = 4U;
+	const auto write = []( Dictionary& dict, int number )
+	{
+		dict.SetInteger( "first", number );
+		dict.SetFloat( "second", float( number ) );
+		dict.SetString( "third", "write " + std::to_string( number ) );
+		dict.SetVec3( "fourth", Vec3( float( number ) ) );
+	};
+
+	Dictionary initial;
+	write( initial, 0 );
+	ConcurrentDictionary shared( initial );
+
+	std::atomic<bool> writing{ true };
+	std::atomic<int> numTorn{ 0 };
+	std::atomic<int> numStale{ 0 };
+	std::atomic<int> numRegressed{ 0 };
+	std::atomic<int> numChanged{ 0 };
+	std::atomic<int> numMidway{ 0 };
+	// How many reads each reader has finished, the writer waits on these
+	Array<std::atomic<size_t>, NumReaders> readsDone;
+	for ( std::atomic<size_t>& reads : readsDone )
+	{
+		reads = 0U;
+	}
+
+	Vector<std::thread> readers;
+	for ( size_t reader = 0U; reader < NumReaders; reader++ )
+	{
+		readers.emplace_back( [&, reader]()
+		{
+			uint64_t lastVersion = 0U;
+			int lastNumber = 0;
+			do
+			{
+				// Everything up to the version seen here is in the snapshot taken after it
+				const uint64_t version = shared.GetVersion();
+				const auto snapshot = shared.Read();
+				const int number = snapshot->GetInteger( "first" );
+
+				// Numbers read as text are formatted on first use, which mustn't race either
+				numTorn += snapshot->GetString( "first" ) == std::to_string( number )
+					&& snapshot->GetFloat( "second" ) == float( number )
+					&& snapshot->GetString( "third" ) == "write " + std::to_string( number )
+					&& snapshot->GetVec3( "fourth" ) == Vec3( float( number ) ) ? 0 : 1;
+				numStale += uint64_t( number ) >= version ? 0 : 1;
+				numRegressed += version >= lastVersion && number >= lastNumber ? 0 : 1;
+				numMidway += number > 0 && number < NumWrites ? 1 : 0;
+
+				// A snapshot doesn't change while it's held, whatever the writer does
+				std::this_thread::yield();
+				numChanged += snapshot->GetInteger( "first" ) == number ? 0 : 1;
+
+				// And neither do the plain getters go back in time
+				const int latest = shared.GetInteger( "first" );
+				numRegressed += latest >= number ? 0 : 1;
+
+				lastVersion = version;
+				lastNumber = latest;
+				readsDone[reader]++;
+			} while ( writing.load() );
+		} );
+	}
+
+	// Waits until every reader has done a whole read after this point, so
+	// they're sure to read in between the writes, however they're scheduled
+	const auto waitForReaders = [&]()
+	{
+		for ( std::atomic<size_t>& reads : readsDone )
+		{
+			// The read that's going on may have started before this point
+			const size_t target = reads.load() + 2U;
+			while ( reads.load() < target )
+			{
+				std::this_thread::yield();
+			}
+		}
+	};
+
+	// Single keys, batches and whole replacements, the writer doesn't wait
+	// for the readers in between, except for a few times along the way
+	for ( int number = 1; number <= NumWrites; number++ )
+	{
+		if ( number % 500 == 0 )
+		{
+			waitForReaders();
+		}
+
+		if ( number % 3 == 0 )
+		{
+			Dictionary replacement;
+			write( replacement, number );
+			shared.Replace( std::move( replacement ) );
+		}
+		else
+		{
+			shared.Update( [&]( Dictionary& dict )
+			{
+				write( dict, number );
+			} );
+		}
+	}
+
+	writing = false;
+	for ( std::thread& reader : readers )
+	{
+		reader.join();
+	}
+
+	Expect( numMidway.load() >= int( NumReaders ), "concurrent: readers read while the writes were going on", failures );
+	Expect( numTorn.load() == 0, "concurrent: snapshots have every key from the same write", failures );
+	Expect( numStale.load() == 0, "concurrent: snapshots are at least as new as the version before them", failures );
+	Expect( numRegressed.load() == 0, "concurrent: versions and values never go backwards", failures );
+	Expect( numChanged.load() == 0, "concurrent: snapshots don't change while held", failures );
+	Expect( shared.GetVersion() == uint64_t( NumWrites ) && shared.GetInteger( "first" ) == NumWrites,
+		"concurrent: every write is counted", failures );
+
+	// The setters, each being a write of its own
+	shared.SetBool( "flag", true );
+	shared.SetString( "name", "rules" );
+	Expect( shared.GetBool( "flag" ) && shared.GetString( "name" ) == "rules" && shared.KeyExists( "fourth" )
+		&& shared.GetVersion() == uint64_t( NumWrites ) + 2U, "concurrent: setters publish a version each", failures );
+
+	// A parent shared by instances on several threads, with numbers that
+	// haven't been formatted yet, which they all read as text at once
+	constexpr int NumParentKeys = 64;
+	Dictionary parentDict;
+	for ( int key = 0; key < NumParentKeys; key++ )
+	{
+		parentDict.SetFloat( "key" + std::to_string( key ), float( key ) + 0.5f );
+	}
+
+	const auto parent = std::make_shared<const Dictionary>( std::move( parentDict ) );
+	std::atomic<size_t> numStarted{ 0U };
+	std::atomic<int> numMisformatted{ 0 };
+	Vector<std::thread> instances;
+	for ( size_t reader = 0U; reader < NumReaders; reader++ )
+	{
+		instances.emplace_back( [&]()
+		{
+			const Dictionary instance( parent );
+			numStarted++;
+			while ( numStarted.load() < NumReaders )
+			{
+				std::this_thread::yield();
+			}
+
+			// Copying the parent reads its values while the others format them
+			const Dictionary copy( *parent );
+			for ( int key = 0; key < NumParentKeys; key++ )
+			{
+				const String keyname = "key" + std::to_string( key );
+				const String expected = DictionaryValue( float( key ) + 0.5f ).GetString();
+				numMisformatted += instance.GetString( keyname ) == expected && copy.GetString( keyname ) == expected ? 0 : 1;
+			}
+		} );
+	}
+
+	for ( std::thread& instance : instances )
+	{
+		instance.join();
+	}
+
+	Expect( numMisformatted.load() == 0, "concurrent: a shared parent's numbers are formatted once for everyone", failures );
+
+	return failures;
+}
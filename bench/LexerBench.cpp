@@ -0,0 +1,623 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#include "Precompiled.hpp"
+#include "Bench.hpp"
+using namespace adm;
+using namespace adm::bench;
+namespace fs = std::filesystem;
+
+// ============================
+// Input generators
+//
+// They all use the same seed, so the
+// inputs are the same from run to run
+// ============================
+class TextGenerator final
+{
+public:
+	TextGenerator( bool crlf = false )
+		: newLine( crlf ? "\r\n" : "\n" )
+	{
+	}
+
+	// xorshift, std distributions differ between standard libraries
+	uint32_t Random( uint32_t max )
+	{
+		state ^= state << 13U;
+		state ^= state >> 17U;
+		state ^= state << 5U;
+		return state % max;
+	}
+
+	template<size_t N>
+	const char* Pick( const char* const (&choices)[N] )
+	{
+		return choices[Random( N )];
+	}
+
+	void Line( const String& line )
+	{
+		text += line;
+		text += newLine;
+	}
+
+	String text;
+
+private:
+	uint32_t state{ 2463534242U };
+	const char* newLine;
+};
+
+// Quake-style entities, almost everything is quoted
+static String GenerateQuoted( size_t size, bool crlf )
+{
+	static constexpr const char* ClassNames[] = { "light", "info_player_start", "func_door", "trigger_multiple", "env_sprite" };
+	static constexpr const char* Keys[] = { "origin", "angles", "targetname", "target", "_light", "model", "spawnflags", "wait" };
+
+	TextGenerator gen( crlf );
+	while ( gen.text.size() < size )
+	{
+		gen.Line( "{" );
+		gen.Line( String( "\"classname\" \"" ) + gen.Pick( ClassNames ) + "\"" );
+
+		const uint32_t numKeys = 2U + gen.Random( 6U );
+		for ( uint32_t i = 0U; i < numKeys; i++ )
+		{
+			const int x = int( gen.Random( 4096U ) ) - 2048;
+			const int y = int( gen.Random( 4096U ) ) - 2048;
+			const int z = int( gen.Random( 512U ) );
+			gen.Line( String( "\"" ) + gen.Pick( Keys ) + "\" \"" + std::to_string( x ) + " " + std::to_string( y ) + " " + std::to_string( z ) + "\"" );
+		}
+
+		gen.Line( "}" );
+	}
+
+	return gen.text;
+}
+
+// Config files that are mostly commentary
+static String GenerateComments( size_t size )
+{
+	static constexpr const char* Comments[] =
+	{
+		"// Controls how far away things stop being drawn",
+		"// Don't set this above 4, \"some\" drivers can't handle it",
+		"//////////////////////////////////////////////",
+		"    // see textures/common/README for the list",
+		"// TODO: this is only here for compatibility",
+	};
+	static constexpr const char* Settings[] = { "r_farz 8192", "r_msaa 4", "snd_volume 0.75", "cl_fov 90", "textures/common/clip" };
+
+	TextGenerator gen;
+	while ( gen.text.size() < size )
+	{
+		const uint32_t numComments = 1U + gen.Random( 4U );
+		for ( uint32_t i = 0U; i < numComments; i++ )
+		{
+			gen.Line( gen.Pick( Comments ) );
+		}
+
+		gen.Line( gen.Pick( Settings ) );
+		gen.Line( "" );
+	}
+
+	return gen.text;
+}
+
+// Script-like code, full of delimiters
+static String GenerateDelimiters( size_t size )
+{
+	static constexpr const char* Statements[] =
+	{
+		"self.health = (base + bonus[3]) * 2;",
+		"if (a > b) { x += y / z; }",
+		"call(one, two, three);",
+		"entity:SetOrigin({ 1, 2, 3 });",
+		"flags = flags & ~mask | (1 << 4);",
+		"list[index] = other.list[index - 1];",
+	};
+
+	TextGenerator gen;
+	while ( gen.text.size() < size )
+	{
+		gen.Line( String( "\t" ) + gen.Pick( Statements ) );
+	}
+
+	return gen.text;
+}
+
+// ============================
+// Benchmarks
+// ============================
+struct LexerCase
+{
+	const char* name;
+	String text;
+	const char* delimiters;
+	bool withDelimiter;
+};
+
+static void BenchmarkCase( const LexerCase& lexerCase, int iterations )
+{
+	const String& text = lexerCase.text;
+	const bool withDelimiter = lexerCase.withDelimiter;
+
+	const auto makeLexer = [&lexerCase]()
+	{
+		Lexer lexer( lexerCase.text );
+		lexer.SetDelimiters( lexerCase.delimiters );
+		return lexer;
+	};
+
+	const auto report = [&lexerCase]( const char* method, const Measurement& measurement )
+	{
+		const String name = String( lexerCase.name ) + " / " + method;
+		Report( "Lexer", name.c_str(), measurement );
+	};
+
+	report( "NextView", Measure( iterations, [&]( Measurement& m )
+		{
+			Lexer lexer = makeLexer();
+			while ( !lexer.NextView( withDelimiter ).empty() )
+			{
+				m.items++;
+			}
+			m.bytes = text.size();
+		} ) );
+
+	report( "NextToken", Measure( iterations, [&]( Measurement& m )
+		{
+			Lexer lexer = makeLexer();
+			while ( !lexer.NextToken( withDelimiter ).IsEndOfFile() )
+			{
+				m.items++;
+			}
+			m.bytes = text.size();
+		} ) );
+
+	// What a parser looking a couple of tokens ahead would do
+	report( "Peek( 2 ), NextToken", Measure( iterations, [&]( Measurement& m )
+		{
+			Lexer lexer = makeLexer();
+			while ( !lexer.NextToken( withDelimiter ).IsEndOfFile() )
+			{
+				lexer.Peek( 2U, withDelimiter );
+				m.items++;
+			}
+			m.bytes = text.size();
+		} ) );
+
+	report( "NextToken, interned", Measure( iterations, [&]( Measurement& m )
+		{
+			Lexer lexer = makeLexer();
+			lexer.SetSymbolTable( std::make_shared<SymbolTable>(), true );
+			while ( !lexer.NextToken( withDelimiter ).IsEndOfFile() )
+			{
+				m.items++;
+			}
+			m.bytes = text.size();
+		} ) );
+
+	report( "NextToken, streamed", Measure( iterations, [&]( Measurement& m )
+		{
+			std::istringstream stream( text );
+			Lexer lexer = Lexer::FromStream( stream );
+			lexer.SetDelimiters( lexerCase.delimiters );
+			while ( !lexer.NextToken( withDelimiter ).IsEndOfFile() )
+			{
+				m.items++;
+			}
+			m.bytes = text.size();
+		} ) );
+
+	report( "TokeniseParallel", Measure( iterations, [&]( Measurement& m )
+		{
+			Lexer lexer = makeLexer();
+			m.items = lexer.TokeniseParallel( withDelimiter ).size();
+			m.bytes = text.size();
+		} ) );
+}
+
+// ============================
+// bench::RunLexerBenchmarks
+// ============================
+void bench::RunLexerBenchmarks( size_t megabytes, int iterations )
+{
+	const size_t size = megabytes * 1024U * 1024U;
+
+	printf( "Lexer: %zu MB per input, best of %i runs, %u hardware threads, M/s is tokens\n",
+		megabytes, iterations, std::thread::hardware_concurrency() );
+
+	const String delimiterText = GenerateDelimiters( size );
+	const LexerCase cases[] =
+	{
+		{ "quoted", GenerateQuoted( size, false ), Lexer::DelimitersSimple, false },
+		{ "quoted, CRLF", GenerateQuoted( size, true ), Lexer::DelimitersSimple, false },
+		{ "comments", GenerateComments( size ), Lexer::DelimitersSimple, false },
+		{ "delimiters, full", delimiterText, Lexer::DelimitersFull, true },
+		{ "delimiters, simple", delimiterText, Lexer::DelimitersSimple, true },
+	};
+
+	for ( const LexerCase& lexerCase : cases )
+	{
+		BenchmarkCase( lexerCase, iterations );
+	}
+}
+
+// ============================
+// Corpus
+//
+// Every .txt file in the corpus has a .tokens file next to it,
+// listing its tokens with both delimiter presets. Reading it
+// through any of the lexer's modes must give the same tokens
+// ============================
+static const char* KindNames[] = { "eof", "identifier", "number", "string", "delimiter" };
+
+static void DumpToken( const Token& token, String& outDump )
+{
+	outDump += std::to_string( token.line ) + ":" + std::to_string( token.column ) + " " + KindNames[token.kind] + " \"";
+
+	for ( const char c : token.text )
+	{
+		switch ( c )
+		{
+		case '\n': outDump += "\\n"; break;
+		case '\r': outDump += "\\r"; break;
+		case '\t': outDump += "\\t"; break;
+		case '"': outDump += "\\\""; break;
+		case '\\': outDump += "\\\\"; break;
+		default: outDump += c; break;
+		}
+	}
+	outDump += "\"";
+
+	if ( token.numeric )
+	{
+		char number[64];
+		snprintf( number, sizeof( number ), " = %.17g", token.number );
+		outDump += number;
+	}
+
+	if ( token.symbol != InvalidSymbol )
+	{
+		outDump += " #" + std::to_string( token.symbol );
+	}
+	outDump += "\n";
+}
+
+// Tokens are dumped as they come, since a
+// streaming lexer's views don't last long
+static String DumpTokens( Lexer& lexer, bool withDelimiter )
+{
+	String result;
+	for ( Token token = lexer.NextToken( withDelimiter ); !token.IsEndOfFile(); token = lexer.NextToken( withDelimiter ) )
+	{
+		DumpToken( token, result );
+	}
+
+	return result;
+}
+
+// Same as above, but every token goes through Peek's lookahead first
+static String DumpPeekedTokens( Lexer& lexer, bool withDelimiter )
+{
+	String result;
+	while ( !lexer.Peek( 0U, withDelimiter ).IsEndOfFile() )
+	{
+		lexer.Peek( Lexer::MaxLookahead - 1U, withDelimiter );
+		DumpToken( lexer.NextToken( withDelimiter ), result );
+	}
+
+	return result;
+}
+
+static String DumpTokens( const Vector<Token>& tokens )
+{
+	String result;
+	for ( const Token& token : tokens )
+	{
+		DumpToken( token, result );
+	}
+
+	return result;
+}
+
+struct LexerConfig
+{
+	const char* header;
+	const char* delimiters;
+	bool withDelimiter;
+};
+
+static constexpr LexerConfig CorpusConfigs[] =
+{
+	{ "# DelimitersSimple\n", Lexer::DelimitersSimple, false },
+	{ "# DelimitersFull\n", Lexer::DelimitersFull, false },
+	{ "# DelimitersFull, with delimiters\n", Lexer::DelimitersFull, true },
+};
+
+static String ReadWholeFile( const fs::path& path )
+{
+	std::ifstream file( path, std::ios::binary );
+	return String( std::istreambuf_iterator<char>( file ), std::istreambuf_iterator<char>() );
+}
+
+static bool Compare( const fs::path& path, const char* what, const String& expected, const String& actual )
+{
+	if ( expected == actual )
+	{
+		return true;
+	}
+
+	// Point out the first line that differs
+	size_t lineStart = 0U;
+	size_t lineNumber = 1U;
+	for ( size_t i = 0U; i < expected.size() && i < actual.size() && expected[i] == actual[i]; i++ )
+	{
+		if ( expected[i] == '\n' )
+		{
+			lineStart = i + 1U;
+			lineNumber++;
+		}
+	}
+
+	const auto lineAt = []( const String& text, size_t from )
+	{
+		return text.substr( from, text.find( '\n', from ) - from );
+	};
+
+	printf( "FAIL %s (%s), line %zu of the dump\n  expected: %s\n  got:      %s\n",
+		path.filename().string().c_str(), what, lineNumber,
+		lineAt( expected, lineStart ).c_str(), lineAt( actual, lineStart ).c_str() );
+
+	return false;
+}
+
+static bool CheckCorpusFile( const fs::path& path, bool update )
+{
+	const String text = ReadWholeFile( path );
+	fs::path expectedPath = path;
+	expectedPath.replace_extension( ".tokens" );
+
+	// The plain in-memory lexer is the reference
+	String reference;
+	for ( const LexerConfig& config : CorpusConfigs )
+	{
+		Lexer lexer( text );
+		lexer.SetDelimiters( config.delimiters );
+		reference += config.header;
+		reference += DumpTokens( lexer, config.withDelimiter );
+	}
+
+	if ( update )
+	{
+		std::ofstream( expectedPath, std::ios::binary ) << reference;
+		printf( "Updated %s\n", expectedPath.filename().string().c_str() );
+		return true;
+	}
+
+	if ( !fs::exists( expectedPath ) )
+	{
+		printf( "FAIL %s has no .tokens file, run with --update to make one\n", path.filename().string().c_str() );
+		return false;
+	}
+
+	bool passed = Compare( path, "in memory", ReadWholeFile( expectedPath ), reference );
+
+	// Memory-mapped
+	String mapped;
+	for ( const LexerConfig& config : CorpusConfigs )
+	{
+		Optional<Lexer> lexer = Lexer::FromFile( path.string() );
+		if ( !lexer )
+		{
+			printf( "FAIL %s could not be mapped\n", path.filename().string().c_str() );
+			return false;
+		}
+
+		lexer->SetDelimiters( config.delimiters );
+		mapped += config.header;
+		mapped += DumpTokens( *lexer, config.withDelimiter );
+	}
+	passed &= Compare( path, "FromFile", reference, mapped );
+
+	// Streamed, tiny chunks of every size make tokens
+	// and comments straddle refills at every offset
+	// Peeking keeps more of the window around, so try that too
+	for ( size_t chunkSize = 16U; chunkSize <= 64U; chunkSize++ )
+	{
+		for ( const bool peeking : { false, true } )
+		{
+			String streamed;
+			for ( const LexerConfig& config : CorpusConfigs )
+			{
+				std::istringstream stream( text );
+				Lexer lexer = Lexer::FromStream( stream, chunkSize );
+				lexer.SetDelimiters( config.delimiters );
+				streamed += config.header;
+				streamed += peeking ? DumpPeekedTokens( lexer, config.withDelimiter ) : DumpTokens( lexer, config.withDelimiter );
+			}
+
+			const String what = "FromStream" + String( peeking ? " with Peek, " : ", " ) + std::to_string( chunkSize ) + " byte chunks";
+			passed &= Compare( path, what.c_str(), reference, streamed );
+		}
+	}
+
+	// Parallel, the file is repeated until it's big enough to be split up
+	if ( !text.empty() )
+	{
+		String repeated;
+		while ( repeated.size() < Lexer::ParallelMinBytes * 4U )
+		{
+			repeated += text;
+			repeated += '\n';
+		}
+
+		for ( const LexerConfig& config : CorpusConfigs )
+		{
+			// Symbols have to come out in the same order too
+			Lexer sequential( repeated );
+			sequential.SetDelimiters( config.delimiters );
+			sequential.SetSymbolTable( std::make_shared<SymbolTable>(), true );
+			Lexer parallel( repeated );
+			parallel.SetDelimiters( config.delimiters );
+			parallel.SetSymbolTable( std::make_shared<SymbolTable>(), true );
+
+			passed &= Compare( path, "TokeniseParallel",
+				DumpTokens( sequential, config.withDelimiter ),
+				DumpTokens( parallel.TokeniseParallel( config.withDelimiter, 4U ) ) );
+		}
+	}
+
+	return passed;
+}
+
+// Everything Next gives until the end, separated by '|'
+static String JoinNext( Lexer& lexer, bool withDelimiter, bool peeking )
+{
+	String result;
+	while ( !lexer.IsEndOfFile() )
+	{
+		if ( peeking )
+		{
+			lexer.Peek( Lexer::MaxLookahead - 1U, withDelimiter );
+		}
+
+		const String token = lexer.Next( withDelimiter );
+		if ( !token.empty() )
+		{
+			result += token;
+			result += '|';
+		}
+	}
+
+	return result;
+}
+
+// Goes through a list of tokens like JoinNext's with Expect,
+// first without advancing, then advancing past each one
+static bool ExpectEach( Lexer& lexer, StringView expected )
+{
+	while ( !expected.empty() )
+	{
+		const size_t end = expected.find( '|' );
+		const StringView token = expected.substr( 0U, end );
+		if ( !lexer.Expect( token ) || !lexer.Expect( token, true ) )
+		{
+			return false;
+		}
+
+		expected.remove_prefix( end + 1U );
+	}
+
+	return true;
+}
+
+// ============================
+// bench::CheckLexerNext
+// ============================
+int bench::CheckLexerNext()
+{
+	int failures = 0;
+
+	struct NextCase
+	{
+		const char* text;
+		const char* expected;
+	};
+
+	// Next glues a quote onto the token right before it, like it always has,
+	// NextToken splits it off, see the quotes corpus file
+	static constexpr NextCase Cases[] =
+	{
+		{ "abc\"def ghi\"x", "abcdef ghi|x|" },
+		{ "a\"b c\"d\"e f\"g h", "ab c|de f|g|h|" },
+		{ "a\"b", "ab|" },
+		{ "x\"\"y z", "x|y|z|" },
+		{ "12\"34\" 5", "1234|5|" },
+		{ "\"abc\"def x", "abc|def|x|" },
+		{ "key \"val ue\" { a;b }", "key|val ue|a|b|" },
+	};
+
+	for ( const NextCase& nextCase : Cases )
+	{
+		Lexer lexer( nextCase.text );
+		Expect( JoinNext( lexer, false, false ) == nextCase.expected, nextCase.text, failures );
+
+		// Peeked tokens are split the NextToken way, Next has to glue them back
+		Lexer peeked( nextCase.text );
+		Expect( JoinNext( peeked, false, true ) == nextCase.expected, "Next after Peek", failures );
+
+		// The quote may start right at the end of a window
+		for ( size_t chunkSize = 16U; chunkSize <= 24U; chunkSize++ )
+		{
+			const String padded = String( 16U, ' ' ) + nextCase.text;
+			std::istringstream stream( padded );
+			Lexer streamed = Lexer::FromStream( stream, chunkSize );
+			Expect( JoinNext( streamed, false, false ) == nextCase.expected, "Next while streaming", failures );
+
+			std::istringstream expectStream( padded );
+			Lexer expectStreamed = Lexer::FromStream( expectStream, chunkSize );
+			Expect( ExpectEach( expectStreamed, nextCase.expected ), "Expect while streaming", failures );
+		}
+
+		// Expect compares against the glued tokens too
+		Lexer expecting( nextCase.text );
+		Expect( ExpectEach( expecting, nextCase.expected ), "Expect like Next", failures );
+
+		Lexer expectPeeked( nextCase.text );
+		expectPeeked.Peek( Lexer::MaxLookahead - 1U );
+		Expect( ExpectEach( expectPeeked, nextCase.expected ), "Expect after Peek", failures );
+	}
+
+	// Empty quotes are skipped before the glued token
+	Lexer emptyQuotes( "\"\" \"\" abc\"def\"" );
+	Expect( emptyQuotes.Expect( "abcdef" ) && !emptyQuotes.Expect( "abc" ) && emptyQuotes.Expect( "abcdef", true ), "Expect past empty quotes", failures );
+
+	// Delimiters are never glued to anything
+	Lexer delimiters( "a;\"b\"c" );
+	Expect( JoinNext( delimiters, true, false ) == "a|;|b|c|", "Next with delimiters", failures );
+
+	// NextView can't glue, it splits
+	Lexer views( "abc\"def ghi\"x" );
+	Expect( views.NextView() == "abc" && views.NextView() == "def ghi" && views.NextView() == "x", "NextView splits at quotes", failures );
+
+	return failures;
+}
+
+// ============================
+// bench::CheckLexerCorpus
+// ============================
+int bench::CheckLexerCorpus( const char* directory, bool update )
+{
+	Vector<fs::path> files;
+	std::error_code error;
+	for ( const fs::directory_entry& entry : fs::directory_iterator( directory, error ) )
+	{
+		if ( entry.path().extension() == ".txt" )
+		{
+			files.push_back( entry.path() );
+		}
+	}
+
+	if ( error || files.empty() )
+	{
+		printf( "FAIL no corpus files in '%s'\n", directory );
+		return 1;
+	}
+
+	std::sort( files.begin(), files.end() );
+
+	int failed = 0;
+	for ( const fs::path& path : files )
+	{
+		if ( !CheckCorpusFile( path, update ) )
+		{
+			failed++;
+		}
+	}
+
+	printf( "Lexer corpus: %zu files, %i failed\n", files.size(), failed );
+	return failed;
+}
@@ -0,0 +1,366 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#include "Precompiled.hpp"
+#include "Bench.hpp"
+using namespace adm;
+using namespace adm::bench;
+
+static volatile size_t SizeSink = 0U;
+
+// Keyvalue names of a typical entity, short enough to not allocate
+static const char* EntityKeys[] =
+{
+	"classname", "targetname", "target", "model", "origin", "angles",
+	"health", "speed", "wait", "spawnflags", "lip", "locked"
+};
+
+// Fills a small map per entity, reads every key back and throws it away,
+// which is what spawning a level does with keyvalues
+template<typename TMap>
+static Measurement SmallMaps( size_t operations, int iterations )
+{
+	return Measure( iterations, [&]( Measurement& m )
+		{
+			size_t sum = 0U;
+			for ( size_t i = 0U; i < operations; i += std::size( EntityKeys ) )
+			{
+				TMap map;
+				for ( const char* key : EntityKeys )
+				{
+					map[key] = int( i );
+				}
+
+				for ( const char* key : EntityKeys )
+				{
+					sum += map.find( key )->second;
+				}
+			}
+			SizeSink = sum;
+			m.items = operations;
+		} );
+}
+
+// Random lookups into one big map, half of which miss
+template<typename TMap>
+static Measurement LargeMap( size_t operations, int iterations )
+{
+	TMap map;
+	for ( uint32_t i = 0U; i < operations; i++ )
+	{
+		map[i * 2U] = i;
+	}
+
+	return Measure( iterations, [&]( Measurement& m )
+		{
+			size_t sum = 0U;
+			uint32_t key = 1U;
+			for ( size_t i = 0U; i < operations; i++ )
+			{
+				key = key * 1664525U + 1013904223U;
+				const auto it = map.find( key % uint32_t( operations * 2U ) );
+				if ( it != map.end() )
+				{
+					sum += it->second;
+				}
+			}
+			SizeSink = sum;
+			m.items = operations;
+		} );
+}
+
+// ============================
+// bench::RunMapBenchmarks
+// ============================
+void bench::RunMapBenchmarks( size_t operations, int iterations )
+{
+	printf( "Map: %zu operations, best of %i runs, M/s is operations\n", operations, iterations );
+
+	Report( "Map", "Small maps, std::unordered_map", SmallMaps<std::unordered_map<String, int>>( operations, iterations ) );
+	Report( "Map", "Small maps, FlatMap", SmallMaps<FlatMap<String, int>>( operations, iterations ) );
+	Report( "Map", "Large map, std::unordered_map", LargeMap<std::unordered_map<uint32_t, uint32_t>>( operations, iterations ) );
+	Report( "Map", "Large map, FlatMap", LargeMap<FlatMap<uint32_t, uint32_t>>( operations, iterations ) );
+}
+
+// ============================
+// Checks
+//
+// FlatMap has to behave exactly like std::unordered_map, since
+// ADMUTIL_USE_FLAT_MAP swaps one for the other across the library
+// ============================
+template<typename TKey, typename TValue>
+static bool SameContents( const FlatMap<TKey, TValue>& map, const std::unordered_map<TKey, TValue>& expected )
+{
+	if ( map.size() != expected.size() || map.empty() != expected.empty() )
+	{
+		return false;
+	}
+
+	// Every entry must be visited exactly once
+	size_t numVisited = 0U;
+	for ( const auto& [key, value] : map )
+	{
+		const auto it = expected.find( key );
+		if ( it == expected.end() || it->second != value )
+		{
+			return false;
+		}
+		numVisited++;
+	}
+
+	for ( const auto& [key, value] : expected )
+	{
+		if ( !map.contains( key ) || map.at( key ) != value || map.count( key ) != 1U )
+		{
+			return false;
+		}
+	}
+
+	return numVisited == expected.size();
+}
+
+// Runs the same random operations on both maps, with few enough
+// distinct keys that they keep getting erased and inserted again
+template<typename TKey, typename MakeKey>
+static void CheckRandomOperations( const char* name, size_t numKeys, const MakeKey& makeKey, int& failures )
+{
+	FlatMap<TKey, uint32_t> map;
+	std::unordered_map<TKey, uint32_t> expected;
+
+	uint32_t seed = 12345U;
+	const auto random = [&seed]()
+	{
+		seed = seed * 1664525U + 1013904223U;
+		return seed >> 8U;
+	};
+
+	char what[128];
+	for ( uint32_t step = 0U; step < 200000U; step++ )
+	{
+		const TKey key = makeKey( random() % numKeys );
+		const uint32_t value = random();
+		switch ( random() % 10U )
+		{
+		case 0U:
+		case 1U:
+		case 2U:
+			map[key] = value;
+			expected[key] = value;
+			break;
+
+		case 3U:
+			map.try_emplace( key, value );
+			expected.try_emplace( key, value );
+			break;
+
+		case 4U:
+			map.insert_or_assign( key, value );
+			expected.insert_or_assign( key, value );
+			break;
+
+		case 5U:
+		case 6U:
+			map.erase( key );
+			expected.erase( key );
+			break;
+
+		case 7U:
+		{
+			// Erasing through the iterator must not skip or repeat entries
+			const auto found = map.find( key );
+			if ( found != map.end() )
+			{
+				map.erase( found );
+				expected.erase( key );
+			}
+			break;
+		}
+
+		case 8U:
+		{
+			const auto found = map.find( key );
+			const auto expectedFound = expected.find( key );
+			if ( (found == map.end()) != (expectedFound == expected.end())
+				|| (found != map.end() && found->second != expectedFound->second) )
+			{
+				snprintf( what, sizeof( what ), "%s: find at step %u", name, step );
+				Expect( false, what, failures );
+				return;
+			}
+			break;
+		}
+
+		default:
+			// Every now and then, force a rehash either way
+			if ( step % 1000U < 5U )
+			{
+				map.reserve( map.size() * 2U + 64U );
+			}
+			break;
+		}
+
+		if ( step % 5000U == 0U )
+		{
+			snprintf( what, sizeof( what ), "%s: contents at step %u", name, step );
+			if ( !Expect( SameContents( map, expected ), what, failures ) )
+			{
+				return;
+			}
+		}
+	}
+
+	snprintf( what, sizeof( what ), "%s: contents after all steps", name );
+	Expect( SameContents( map, expected ), what, failures );
+
+	// Copies and moves carry everything over
+	FlatMap<TKey, uint32_t> copy( map );
+	snprintf( what, sizeof( what ), "%s: copy", name );
+	Expect( SameContents( copy, expected ), what, failures );
+
+	FlatMap<TKey, uint32_t> moved( std::move( copy ) );
+	snprintf( what, sizeof( what ), "%s: move", name );
+	Expect( SameContents( moved, expected ), what, failures );
+
+	// Erasing everything while iterating leaves nothing behind
+	for ( auto it = moved.begin(); it != moved.end(); )
+	{
+		it = moved.erase( it );
+	}
+	snprintf( what, sizeof( what ), "%s: erase while iterating", name );
+	Expect( moved.empty() && moved.begin() == moved.end(), what, failures );
+
+	map.clear();
+	expected.clear();
+	snprintf( what, sizeof( what ), "%s: clear", name );
+	Expect( SameContents( map, expected ), what, failures );
+}
+
+// A key that can't be copied, so growing a map full of them has to move them
+struct MoveOnlyKey
+{
+	explicit MoveOnlyKey( uint32_t id )
+		: id( id )
+	{
+	}
+
+	MoveOnlyKey( MoveOnlyKey&& other ) noexcept = default;
+	MoveOnlyKey( const MoveOnlyKey& other ) = delete;
+
+	bool operator==( const MoveOnlyKey& other ) const
+	{
+		return id == other.id;
+	}
+
+	uint32_t id;
+};
+
+template<>
+struct adm::FlatMapHash<MoveOnlyKey>
+{
+	size_t operator()( const MoveOnlyKey& key ) const
+	{
+		return key.id;
+	}
+};
+
+// Move-only keys and values, inserted one by one from an empty map,
+// so they go through every rehash along the way
+static void CheckMoveOnly( int& failures )
+{
+	FlatMap<MoveOnlyKey, UniquePtr<uint32_t>> map;
+	constexpr uint32_t NumKeys = 5000U;
+	for ( uint32_t i = 0U; i < NumKeys; i++ )
+	{
+		if ( i % 2U == 0U )
+		{
+			map.try_emplace( MoveOnlyKey( i ), std::make_unique<uint32_t>( i * 3U ) );
+		}
+		else
+		{
+			map.emplace( MoveOnlyKey( i ), std::make_unique<uint32_t>( i * 3U ) );
+		}
+	}
+
+	bool allThere = map.size() == NumKeys;
+	for ( uint32_t i = 0U; i < NumKeys && allThere; i++ )
+	{
+		const auto found = map.find( MoveOnlyKey( i ) );
+		allThere = found != map.end() && found->first.id == i && *found->second == i * 3U;
+	}
+	Expect( allThere, "move-only: every key and value survives rehashing", failures );
+
+	Expect( !map.try_emplace( MoveOnlyKey( 7U ), nullptr ).second && *map.at( MoveOnlyKey( 7U ) ) == 21U,
+		"move-only: existing keys are left alone", failures );
+}
+
+// How many times CountedKeys were compared, control bytes rule out all
+// but 1 in 128 of the other keys along a probe, so a lookup that has to
+// go far compares a lot more than the one key it's looking for
+static size_t NumKeyComparisons = 0U;
+
+struct CountedKey
+{
+	bool operator==( const CountedKey& other ) const
+	{
+		NumKeyComparisons++;
+		return value == other.value;
+	}
+
+	uint64_t value;
+};
+
+template<>
+struct adm::FlatMapHash<CountedKey>
+{
+	size_t operator()( const CountedKey& key ) const
+	{
+		return std::hash<uint64_t>()( key.value );
+	}
+};
+
+// Integer keys with their low bits clear, like shifted IDs and aligned
+// pointers, have to spread over the groups like any others do
+static void CheckStridedKeys( int& failures )
+{
+	constexpr uint32_t NumKeys = 20000U;
+	for ( const uint32_t shift : { 4U, 12U, 20U, 32U, 40U } )
+	{
+		FlatMap<CountedKey, uint32_t> map;
+		for ( uint32_t i = 0U; i < NumKeys; i++ )
+		{
+			map[CountedKey{ uint64_t( i ) << shift }] = i;
+		}
+
+		NumKeyComparisons = 0U;
+		bool allThere = map.size() == NumKeys;
+		for ( uint32_t i = 0U; i < NumKeys; i++ )
+		{
+			const auto found = map.find( CountedKey{ uint64_t( i ) << shift } );
+			allThere &= found != map.end() && found->second == i;
+		}
+
+		char what[64];
+		snprintf( what, sizeof( what ), "strided: keys shifted by %u are all there", shift );
+		Expect( allThere, what, failures );
+		// Lookups that all start from the same group compare hundreds of keys each
+		snprintf( what, sizeof( what ), "strided: keys shifted by %u have short probes", shift );
+		Expect( NumKeyComparisons < NumKeys + NumKeys / 8U, what, failures );
+	}
+}
+
+// ============================
+// bench::CheckFlatMap
+// ============================
+int bench::CheckFlatMap()
+{
+	int failures = 0;
+
+	CheckRandomOperations<uint32_t>( "integers", 3000U, []( uint32_t i ) { return i * 2654435761U; }, failures );
+	CheckRandomOperations<String>( "strings", 500U, []( uint32_t i ) { return "key" + std::to_string( i ); }, failures );
+	// Keys that only differ in their high bits, which std::hash leaves as they are
+	CheckRandomOperations<uint64_t>( "colliding", 200U, []( uint32_t i ) { return uint64_t( i ) << 40U; }, failures );
+	CheckMoveOnly( failures );
+	CheckStridedKeys( failures );
+
+	return failures;
+}
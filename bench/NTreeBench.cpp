@@ -0,0 +1,547 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#include "Precompiled.hpp"
+#include "Bench.hpp"
+using namespace adm;
+using namespace adm::bench;
+
+static volatile float FloatSink = 0.0f;
+
+// The same points every run, scattered over a map-sized box
+static Vector<Vec3> MakePoints( size_t count, const AABB& bounds )
+{
+	Vector<Vec3> points;
+	points.reserve( count );
+
+	uint32_t seed = 1U;
+	const auto random = [&]( float min, float max )
+	{
+		seed = seed * 1664525U + 1013904223U;
+		return min + (max - min) * float( seed >> 8 ) / float( 1U << 24 );
+	};
+
+	for ( size_t i = 0U; i < count; i++ )
+	{
+		points.emplace_back(
+			random( bounds.mins.x, bounds.maxs.x ),
+			random( bounds.mins.y, bounds.maxs.y ),
+			random( bounds.mins.z, bounds.maxs.z ) );
+	}
+
+	return points;
+}
+
+// ============================
+// bench::RunNTreeBenchmarks
+// ============================
+void bench::RunNTreeBenchmarks( size_t operations, int iterations )
+{
+	const size_t numPoints = std::max<size_t>( operations / 4U, 1U );
+	printf( "NTree: octree of %zu points, best of %i runs, M/s is points, or queries\n", numPoints, iterations );
+
+	const auto report = []( const char* name, const Measurement& measurement )
+	{
+		Report( "NTree", name, measurement );
+	};
+
+	const AABB bounds( Vec3( -4096.0f ), Vec3( 4096.0f ) );
+	Octree<Vec3> octree( bounds, utils::IntersectsAABB, utils::OccupiesBox, utils::SimpleThreshold<Vec3, 16>, utils::GetAABBForChild );
+	octree.SetElements( MakePoints( numPoints, bounds ) );
+
+	report( "Rebuild", Measure( iterations, [&]( Measurement& m )
+		{
+			octree.Rebuild();
+			m.items = numPoints;
+		} ) );
+
+	// Same functions, but they can be inlined
+	using StaticPolicy = OctreeStaticPolicy<Vec3, utils::IntersectsAABB, utils::SimpleThreshold<Vec3, 16>>;
+	Octree<Vec3, StaticPolicy> staticOctree( bounds );
+	staticOctree.SetElements( Vector<Vec3>( octree.GetElements() ) );
+	report( "Rebuild, static policy", Measure( iterations, [&]( Measurement& m )
+		{
+			staticOctree.Rebuild();
+			m.items = numPoints;
+		} ) );
+
+	// One thread per hardware thread, the tree comes out the same
+	TaskPool pool( 0U );
+	report( "Rebuild, static policy, parallel", Measure( iterations, [&]( Measurement& m )
+		{
+			staticOctree.Rebuild( pool );
+			m.items = numPoints;
+		} ) );
+
+	// Radix-sorted Morton codes instead of box tests
+	report( "RebuildLinear, static policy", Measure( iterations, [&]( Measurement& m )
+		{
+			staticOctree.RebuildLinear();
+			m.items = numPoints;
+		} ) );
+
+	report( "Leaves, ForEachElement", Measure( iterations, [&]( Measurement& m )
+		{
+			float sum = 0.0f;
+			for ( const uint32_t leaf : octree.GetLeaves() )
+			{
+				octree.ForEachElement( octree.GetNode( leaf ), [&]( const Vec3& point )
+					{
+						sum += point.x;
+					} );
+			}
+			FloatSink = sum;
+			m.items = numPoints;
+		} ) );
+
+	// Queries scattered around the map, a thousand of each
+	constexpr size_t NumQueries = 1000U;
+	const Vector<Vec3> queryPoints = MakePoints( NumQueries * 2U, bounds );
+	Vector<uint32_t> results;
+
+	report( "QueryBox, 256 units", Measure( iterations, [&]( Measurement& m )
+		{
+			size_t found = 0U;
+			for ( size_t i = 0U; i < NumQueries; i++ )
+			{
+				results.clear();
+				found += octree.QueryBox( AABB( queryPoints[i] - Vec3( 128.0f ), queryPoints[i] + Vec3( 128.0f ) ), results );
+			}
+			FloatSink = float( found );
+			m.items = NumQueries;
+		} ) );
+
+	report( "QuerySphere, 256 units", Measure( iterations, [&]( Measurement& m )
+		{
+			size_t found = 0U;
+			for ( size_t i = 0U; i < NumQueries; i++ )
+			{
+				results.clear();
+				found += octree.QuerySphere( queryPoints[i], 256.0f, results, utils::PointInSphere );
+			}
+			FloatSink = float( found );
+			m.items = NumQueries;
+		} ) );
+
+	// A view pyramid, 45 degrees wide and 1024 units deep, looking along a different axis each time
+	report( "QueryFrustum", Measure( iterations, [&]( Measurement& m )
+		{
+			const float sine = std::sin( 0.4f );
+			const float cosine = std::cos( 0.4f );
+			size_t found = 0U;
+			for ( size_t i = 0U; i < NumQueries; i++ )
+			{
+				const Vec3& eye = queryPoints[i];
+				const Vec3 axes[]{ Vec3::Forward, -Vec3::Right, Vec3::Up };
+				const Vec3& forward = axes[i % 3U];
+				const Vec3& side = axes[(i + 1U) % 3U];
+				const Vec3& up = axes[(i + 2U) % 3U];
+				const auto throughEye = [&]( const Vec3& normal )
+				{
+					return Plane( normal, normal * eye );
+				};
+
+				const Plane planes[]
+				{
+					throughEye( forward * sine + side * cosine ),
+					throughEye( forward * sine - side * cosine ),
+					throughEye( forward * sine + up * cosine ),
+					throughEye( forward * sine - up * cosine ),
+					throughEye( forward ),
+					Plane( -forward, -(forward * eye) - 1024.0f ),
+				};
+				results.clear();
+				found += octree.QueryFrustum( planes, std::size( planes ), results, utils::PointInPlanes );
+			}
+			FloatSink = float( found );
+			m.items = NumQueries;
+		} ) );
+
+	octree.SetElementMargin( 4.0f );
+	report( "RayCast, nearest hit", Measure( iterations, [&]( Measurement& m )
+		{
+			float sum = 0.0f;
+			for ( size_t i = 0U; i < NumQueries; i++ )
+			{
+				uint32_t element = 0U;
+				float fraction = 1.0f;
+				if ( octree.RayCast( queryPoints[i], queryPoints[NumQueries + i], utils::PointRayTest{ 4.0f }, element, fraction ) )
+				{
+					sum += fraction;
+				}
+			}
+			FloatSink = sum;
+			m.items = NumQueries;
+		} ) );
+	octree.SetElementMargin( 0.0f );
+}
+
+// ============================
+// Checks
+// ============================
+
+// A query, and how big it is, the box's half-size, the sphere's radius and so on
+struct CheckQuery
+{
+	Vec3 centre;
+	float size;
+};
+
+// @returns The indices sorted, queries don't give them in any particular order
+static Vector<uint32_t> Sorted( Vector<uint32_t> indices )
+{
+	std::sort( indices.begin(), indices.end() );
+	return indices;
+}
+
+// Every query against testing each element that made it into the tree
+template<typename TreeType>
+static void CheckQueries( TreeType& octree, const Vector<CheckQuery>& queries, int& failures )
+{
+	const AABB& bounds = octree.GetBoundingVolume();
+	const Vector<Vec3>& points = octree.GetElements();
+	const auto bruteForce = [&]( auto&& test )
+	{
+		Vector<uint32_t> indices;
+		for ( uint32_t i = 0U; i < points.size(); i++ )
+		{
+			if ( bounds.IsInside( points[i] ) && test( points[i] ) )
+			{
+				indices.push_back( i );
+			}
+		}
+		return indices;
+	};
+
+	int numBoxes = 0;
+	int numSpheres = 0;
+	int numFrustums = 0;
+	int numRays = 0;
+	Vector<uint32_t> results;
+	for ( size_t i = 0U; i < queries.size(); i++ )
+	{
+		const Vec3& centre = queries[i].centre;
+		const float size = queries[i].size;
+
+		// Results are appended, and the count is only of the new ones
+		const AABB box( centre - Vec3( size ), centre + Vec3( size ) );
+		results.assign( 3U, 0U );
+		const size_t found = octree.QueryBox( box, results );
+		results.erase( results.begin(), results.begin() + 3 );
+		numBoxes += found == results.size() && Sorted( results ) == bruteForce( [&]( const Vec3& point )
+			{
+				return box.IsInside( point );
+			} ) ? 0 : 1;
+
+		results.clear();
+		octree.QuerySphere( centre, size, results, utils::PointInSphere );
+		numSpheres += Sorted( results ) == bruteForce( [&]( const Vec3& point )
+			{
+				return utils::PointInSphere( point, centre, size );
+			} ) ? 0 : 1;
+
+		// A camera somewhere around the centre, looking somewhere else each time
+		const Vec3 angles( float( i * 37U % 180U ) - 90.0f, float( i * 91U % 360U ), 0.0f );
+		const Mat4 viewProjection = Mat4::View( centre, angles ) * Mat4::Perspective( 1.2f, 1.5f, size * 0.01f, size * 8.0f );
+		const Array<Plane, 6> planes = Plane::FrustumFromViewProjection( viewProjection );
+		results.clear();
+		octree.QueryFrustum( viewProjection, results, utils::PointInPlanes );
+		numFrustums += Sorted( results ) == bruteForce( [&]( const Vec3& point )
+			{
+				return utils::PointInPlanes( point, planes.data(), planes.size() );
+			} ) ? 0 : 1;
+
+		// Without the near and far planes, it's an endless pyramid
+		results.clear();
+		octree.QueryFrustum( planes.data(), 4U, results, utils::PointInPlanes );
+		numFrustums += Sorted( results ) == bruteForce( [&]( const Vec3& point )
+			{
+				return utils::PointInPlanes( point, planes.data(), 4U );
+			} ) ? 0 : 1;
+
+		// Points are hit as spheres, so they stick out of their nodes by that much
+		const utils::PointRayTest rayTest{ size * 0.125f };
+		const Vec3 direction = Vec3( std::sin( float( i ) ), std::cos( float( i ) * 0.7f ), std::sin( float( i ) * 1.3f ) ) * size * 4.0f;
+		const Vec3 start = centre - direction;
+		const Vec3 end = centre + direction;
+		float closest = FLT_MAX;
+		for ( const uint32_t index : bruteForce( [&]( const Vec3& ) { return true; } ) )
+		{
+			float fraction = 1.0f;
+			if ( rayTest( points[index], start, end, fraction ) && fraction >= 0.0f )
+			{
+				closest = std::min( closest, fraction );
+			}
+		}
+
+		octree.SetElementMargin( rayTest.radius );
+		uint32_t element = 0U;
+		float fraction = 1.0f;
+		float elementFraction = 1.0f;
+		if ( octree.RayCast( start, end, rayTest, element, fraction ) )
+		{
+			numRays += fraction == closest && rayTest( points[element], start, end, elementFraction ) && elementFraction == fraction ? 0 : 1;
+		}
+		else
+		{
+			numRays += closest == FLT_MAX ? 0 : 1;
+		}
+		octree.SetElementMargin( 0.0f );
+	}
+
+	Expect( numBoxes == 0, "ntree: QueryBox finds what testing every element does", failures );
+	Expect( numSpheres == 0, "ntree: QuerySphere finds what testing every element does", failures );
+	Expect( numFrustums == 0, "ntree: QueryFrustum finds what testing every element does", failures );
+	Expect( numRays == 0, "ntree: RayCast hits the nearest element", failures );
+}
+
+// ============================
+// bench::CheckNTreeQueries
+// ============================
+int bench::CheckNTreeQueries()
+{
+	int failures = 0;
+
+	// Points all over the place, a few of them outside the tree
+	const AABB bounds( Vec3( -4096.0f ), Vec3( 4096.0f ) );
+	Vector<Vec3> points = MakePoints( 10000U, AABB( Vec3( -4200.0f ), Vec3( 4200.0f ) ) );
+
+	Vector<CheckQuery> queries;
+	for ( const Vec3& centre : MakePoints( 200U, bounds ) )
+	{
+		queries.push_back( { centre, 64.0f * float( 1U << (queries.size() % 5U) ) } );
+	}
+	queries.push_back( { Vec3::Zero, 8192.0f } );
+
+	Octree<Vec3> octree( bounds, utils::IntersectsAABB, utils::OccupiesBox, utils::SimpleThreshold<Vec3, 16>, utils::GetAABBForChild );
+	octree.SetElements( Vector<Vec3>( points ) );
+	octree.Rebuild();
+	CheckQueries( octree, queries, failures );
+
+	// With no angles the camera looks along +X, so what's in front is in the frustum, and what's behind or too far isn't
+	const Array<Plane, 6> planes = Plane::FrustumFromViewProjection(
+		Mat4::View( Vec3::Zero, Vec3::Zero ) * Mat4::Perspective( 1.2f, 1.5f, 1.0f, 1000.0f ) );
+	Expect( utils::PointInPlanes( Vec3( 100.0f, 0.0f, 0.0f ), planes.data(), planes.size() )
+		&& !utils::PointInPlanes( Vec3( -100.0f, 0.0f, 0.0f ), planes.data(), planes.size() )
+		&& !utils::PointInPlanes( Vec3( 2000.0f, 0.0f, 0.0f ), planes.data(), planes.size() ),
+		"ntree: frustum planes face into the frustum", failures );
+
+	// A tight cluster, so the tree goes deep enough that queries keep their node stack on the heap
+	for ( uint32_t i = 1U; i <= 64U; i++ )
+	{
+		const float offset = float( i ) * 1.0e-12f;
+		points.emplace_back( offset, offset * 0.5f, offset * 0.25f );
+		queries.push_back( { points.back(), 4.0e-12f * float( 1U << (i % 4U) ) } );
+	}
+
+	using StaticPolicy = OctreeStaticPolicy<Vec3, utils::IntersectsAABB, utils::SimpleThreshold<Vec3, 16>>;
+	Octree<Vec3, StaticPolicy> deepOctree( bounds );
+	deepOctree.SetElements( std::move( points ) );
+	deepOctree.Rebuild();
+	Expect( deepOctree.GetDepth() * 7U + 1U > 256U, "ntree: the clustered tree needs the bigger node stack", failures );
+	CheckQueries( deepOctree, queries, failures );
+
+	return failures;
+}
+
+// @returns Whether the trees have the same nodes, leaves and depth, and the same
+// element indices, either in the same order, or only the same ones in each leaf
+template<typename TreeA, typename TreeB>
+static bool SameTree( const TreeA& a, const TreeB& b, bool sameElementOrder )
+{
+	const auto sameNode = []( const auto& nodeA, const auto& nodeB )
+	{
+		return nodeA.GetBoundingVolume().mins == nodeB.GetBoundingVolume().mins
+			&& nodeA.GetBoundingVolume().maxs == nodeB.GetBoundingVolume().maxs
+			&& nodeA.GetFirstChild() == nodeB.GetFirstChild()
+			&& nodeA.GetFirstElement() == nodeB.GetFirstElement()
+			&& nodeA.GetNumElements() == nodeB.GetNumElements();
+	};
+
+	if ( a.GetDepth() != b.GetDepth() || a.GetLeaves() != b.GetLeaves()
+		|| !std::equal( a.GetNodes().begin(), a.GetNodes().end(), b.GetNodes().begin(), b.GetNodes().end(), sameNode ) )
+	{
+		return false;
+	}
+
+	if ( sameElementOrder )
+	{
+		return a.GetElementIndices() == b.GetElementIndices();
+	}
+
+	for ( const uint32_t leaf : a.GetLeaves() )
+	{
+		const auto& node = a.GetNode( leaf );
+		const auto first = a.GetElementIndices().begin() + node.GetFirstElement();
+		Vector<uint32_t> indicesA( first, first + node.GetNumElements() );
+		Vector<uint32_t> indicesB( b.GetElementIndices().begin() + node.GetFirstElement(),
+			b.GetElementIndices().begin() + node.GetFirstElement() + node.GetNumElements() );
+		if ( Sorted( std::move( indicesA ) ) != Sorted( std::move( indicesB ) ) )
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// Scattered points, and a dense blob in one corner, so
+// big subtrees get handed off inside other handed-off ones
+static Vector<Vec3> MakeParallelPoints( const AABB& bounds )
+{
+	Vector<Vec3> points = MakePoints( 60000U, bounds );
+	const Vector<Vec3> blob = MakePoints( 80000U, AABB( Vec3( 64.0f ), Vec3( 1500.0f ) ) );
+	points.insert( points.end(), blob.begin(), blob.end() );
+	return points;
+}
+
+// ============================
+// bench::CheckNTreeParallel
+// ============================
+int bench::CheckNTreeParallel()
+{
+	int failures = 0;
+
+	const AABB bounds( Vec3( -4096.0f ), Vec3( 4096.0f ) );
+	using StaticPolicy = OctreeStaticPolicy<Vec3, utils::IntersectsAABB, utils::SimpleThreshold<Vec3, 16>>;
+	Octree<Vec3, StaticPolicy> serial( bounds );
+	serial.SetElements( MakeParallelPoints( bounds ) );
+	serial.Rebuild();
+
+	// Any number of threads gives the tree a serial build would
+	Octree<Vec3, StaticPolicy> parallel( bounds );
+	parallel.SetElements( Vector<Vec3>( serial.GetElements() ) );
+	for ( const size_t numThreads : { 2U, 3U, 8U, 0U } )
+	{
+		parallel.Rebuild( numThreads );
+		Expect( SameTree( serial, parallel, true ), "parallel: same tree with any number of threads", failures );
+	}
+
+	// A pool can be kept and used over and over
+	TaskPool pool( 4U );
+	for ( int i = 0; i < 2; i++ )
+	{
+		parallel.Rebuild( pool );
+		Expect( SameTree( serial, parallel, true ), "parallel: same tree with the caller's pool", failures );
+	}
+
+	// std::functions, called from all threads at once
+	Octree<Vec3> functionTree( bounds, utils::IntersectsAABB, utils::OccupiesBox, utils::SimpleThreshold<Vec3, 16>, utils::GetAABBForChild );
+	functionTree.SetElements( Vector<Vec3>( serial.GetElements() ) );
+	functionTree.Rebuild( pool );
+	Expect( SameTree( serial, functionTree, true ), "parallel: same tree with the function policy", failures );
+
+	// A policy that throws halfway through doesn't leave the other threads hanging
+	std::atomic<int> numSubdivisions{ 0 };
+	Octree<Vec3> throwingTree( bounds, utils::IntersectsAABB, utils::OccupiesBox,
+		[&numSubdivisions]( const OctreeNode<Vec3*>& node )
+		{
+			if ( node.GetNumElements() > 16 && ++numSubdivisions == 2000 )
+			{
+				throw std::runtime_error( "policy failed" );
+			}
+			return node.GetNumElements() > 16;
+		}, utils::GetAABBForChild );
+	throwingTree.SetElements( Vector<Vec3>( serial.GetElements() ) );
+	bool thrown = false;
+	try
+	{
+		throwingTree.Rebuild( pool );
+	}
+	catch ( const std::runtime_error& )
+	{
+		thrown = true;
+	}
+	Expect( thrown, "parallel: exceptions come out of Rebuild", failures );
+
+	// The pool on its own: every task runs once, throwing ones included, and it still works afterwards
+	std::atomic<int> numRuns{ 0 };
+	const auto spawnTree = [&]( auto& self, size_t worker, int level ) -> void
+	{
+		numRuns++;
+		if ( level == 0 )
+		{
+			return;
+		}
+
+		for ( int child = 0; child < 4; child++ )
+		{
+			pool.Spawn( worker, [&self, level]( size_t worker ) { self( self, worker, level - 1 ); } );
+		}
+	};
+
+	for ( int run = 0; run < 20; run++ )
+	{
+		numRuns = 0;
+		pool.Run( [&]( size_t worker ) { spawnTree( spawnTree, worker, 5 ); } );
+		Expect( numRuns.load() == 1365, "pool: every task runs once", failures );
+	}
+
+	thrown = false;
+	numRuns = 0;
+	try
+	{
+		pool.Run( [&]( size_t worker )
+		{
+			for ( int i = 0; i < 64; i++ )
+			{
+				pool.Spawn( worker, [&numRuns, i]( size_t )
+				{
+					numRuns++;
+					if ( i % 8 == 0 )
+					{
+						throw std::runtime_error( "task failed" );
+					}
+				} );
+			}
+		} );
+	}
+	catch ( const std::runtime_error& )
+	{
+		thrown = true;
+	}
+	Expect( thrown && numRuns.load() == 64, "pool: throwing tasks still let the others finish", failures );
+
+	numRuns = 0;
+	pool.Run( [&]( size_t worker ) { spawnTree( spawnTree, worker, 3 ); } );
+	Expect( numRuns.load() == 85, "pool: works after a task threw", failures );
+
+	return failures;
+}
+
+// ============================
+// bench::CheckNTreeLinear
+// ============================
+int bench::CheckNTreeLinear()
+{
+	int failures = 0;
+
+	// Scattered points, plus some right on the planes the nodes are split along
+	const AABB bounds( Vec3( -4096.0f ), Vec3( 4096.0f ) );
+	Vector<Vec3> points = MakeParallelPoints( bounds );
+	const float splits[] = { -4096.0f, -2048.0f, -1024.0f, -3.0f * 512.0f, 0.0f, 256.0f, 1024.0f, 3072.0f, 4096.0f };
+	for ( size_t i = 0U; i < 2000U; i++ )
+	{
+		points.emplace_back( splits[i % std::size( splits )], points[i].y, splits[(i / 3U) % std::size( splits )] );
+	}
+
+	using StaticPolicy = OctreeStaticPolicy<Vec3, utils::IntersectsAABB, utils::SimpleThreshold<Vec3, 16>>;
+	Octree<Vec3, StaticPolicy> octree( bounds );
+	octree.SetElements( Vector<Vec3>( points ) );
+	octree.Rebuild();
+
+	Octree<Vec3, StaticPolicy> linear( bounds );
+	linear.SetElements( std::move( points ) );
+
+	// The same nodes and leaves, but the elements within a node come in Morton order
+	linear.RebuildLinear( 21U );
+	Expect( SameTree( octree, linear, false ), "linear: same tree as Rebuild with 63-bit codes", failures );
+	linear.RebuildLinear();
+	Expect( SameTree( octree, linear, false ), "linear: same tree as Rebuild with 30-bit codes", failures );
+
+	// Fewer levels than the tree needs, nodes at the bottom just keep all of their elements
+	linear.RebuildLinear( 2U );
+	Expect( linear.GetDepth() == 3U && linear.GetNodes().size() == 1U + 8U + 64U, "linear: stops at the given depth", failures );
+
+	return failures;
+}
@@ -0,0 +1,191 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#include "Precompiled.hpp"
+using namespace adm;
+
+// Spreads threads across the reader stripes in the order they first read
+static std::atomic<size_t> NextReaderStripe{ 0U };
+
+// ============================
+// ConcurrentDictionary::Snapshot::ctor
+// ============================
+ConcurrentDictionary::Snapshot::Snapshot( std::atomic<uint32_t>* readers, const Dictionary* dict )
+	: readers( readers ), dict( dict )
+{
+}
+
+// ============================
+// ConcurrentDictionary::Snapshot::ctor
+// ============================
+ConcurrentDictionary::Snapshot::Snapshot( Snapshot&& snapshot ) noexcept
+	: readers( snapshot.readers ), dict( snapshot.dict )
+{
+	snapshot.readers = nullptr;
+	snapshot.dict = nullptr;
+}
+
+// ============================
+// ConcurrentDictionary::Snapshot::dtor
+// ============================
+ConcurrentDictionary::Snapshot::~Snapshot()
+{
+	if ( nullptr != readers )
+	{
+		// Release, so everything this reader did with the
+		// dictionary happens before a writer frees it
+		readers->fetch_sub( 1U, std::memory_order_release );
+	}
+}
+
+// ============================
+// ConcurrentDictionary::ctor
+// ============================
+ConcurrentDictionary::ConcurrentDictionary()
+	: ConcurrentDictionary( Dictionary() )
+{
+}
+
+// ============================
+// ConcurrentDictionary::ctor
+// ============================
+ConcurrentDictionary::ConcurrentDictionary( Dictionary dict )
+{
+	current.store( new Dictionary( std::move( dict ) ) );
+}
+
+// ============================
+// ConcurrentDictionary::dtor
+// ============================
+ConcurrentDictionary::~ConcurrentDictionary()
+{
+	delete current.load();
+}
+
+// ============================
+// ConcurrentDictionary::Read
+// 
+// The reader is counted before it loads the pointer, so a
+// writer that has published a new dictionary and then sees
+// no readers knows that any later reader gets the new one
+// ============================
+ConcurrentDictionary::Snapshot ConcurrentDictionary::Read() const
+{
+	static thread_local const size_t stripe = NextReaderStripe.fetch_add( 1U, std::memory_order_relaxed ) % NumReaderStripes;
+
+	std::atomic<uint32_t>* readers = &stripes[stripe].readers[generation.load() & 1U];
+	readers->fetch_add( 1U );
+	return Snapshot( readers, current.load() );
+}
+
+std::string ConcurrentDictionary::GetString( StringView keyname, const char* defaultValue ) const
+{
+	return Read()->GetString( keyname, defaultValue );
+}
+
+float ConcurrentDictionary::GetFloat( StringView keyname, const float& defaultValue ) const
+{
+	return Read()->GetFloat( keyname, defaultValue );
+}
+
+int ConcurrentDictionary::GetInteger( StringView keyname, const int& defaultValue ) const
+{
+	return Read()->GetInteger( keyname, defaultValue );
+}
+
+bool ConcurrentDictionary::GetBool( StringView keyname, const bool& defaultValue ) const
+{
+	return Read()->GetBool( keyname, defaultValue );
+}
+
+Vec3 ConcurrentDictionary::GetVec3( StringView keyname, const Vec3& defaultValue ) const
+{
+	return Read()->GetVec3( keyname, defaultValue );
+}
+
+bool ConcurrentDictionary::KeyExists( StringView keyname ) const
+{
+	return Read()->KeyExists( keyname );
+}
+
+void ConcurrentDictionary::SetString( StringView keyname, StringView value )
+{
+	Update( [&]( Dictionary& dict )
+		{
+			dict.SetString( keyname, value );
+		} );
+}
+
+void ConcurrentDictionary::SetFloat( StringView keyname, float value )
+{
+	Update( [&]( Dictionary& dict )
+		{
+			dict.SetFloat( keyname, value );
+		} );
+}
+
+void ConcurrentDictionary::SetInteger( StringView keyname, int value )
+{
+	Update( [&]( Dictionary& dict )
+		{
+			dict.SetInteger( keyname, value );
+		} );
+}
+
+void ConcurrentDictionary::SetBool( StringView keyname, bool value )
+{
+	Update( [&]( Dictionary& dict )
+		{
+			dict.SetBool( keyname, value );
+		} );
+}
+
+void ConcurrentDictionary::SetVec3( StringView keyname, const Vec3& value )
+{
+	Update( [&]( Dictionary& dict )
+		{
+			dict.SetVec3( keyname, value );
+		} );
+}
+
+// ============================
+// ConcurrentDictionary::Replace
+// ============================
+void ConcurrentDictionary::Replace( Dictionary dict )
+{
+	std::lock_guard<std::mutex> lock( writeMutex );
+	Publish( std::move( dict ) );
+}
+
+uint64_t ConcurrentDictionary::GetVersion() const
+{
+	return version.load( std::memory_order_acquire );
+}
+
+// ============================
+// ConcurrentDictionary::Publish
+// 
+// Readers who may have the old dictionary were counted in one
+// generation or the other before it was swapped out, so the
+// generation is flipped twice, each time waiting for the one
+// that new readers no longer go to, to drain
+// ============================
+void ConcurrentDictionary::Publish( Dictionary&& dict )
+{
+	const Dictionary* old = current.exchange( new Dictionary( std::move( dict ) ) );
+	version.fetch_add( 1U, std::memory_order_release );
+
+	for ( int flip = 0; flip < 2; flip++ )
+	{
+		const uint32_t drained = generation.fetch_add( 1U ) & 1U;
+		for ( ReaderStripe& stripe : stripes )
+		{
+			while ( stripe.readers[drained].load() != 0U )
+			{
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	delete old;
+}
@@ -0,0 +1,129 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+namespace adm
+{
+	// ============================
+	// ConcurrentDictionary
+	//
+	// A dictionary that many threads read while one at a time
+	// writes to it, e.g. cvars or game rules on a server
+	// Usage:
+	//
+	// ConcurrentDictionary rules;
+	// rules.SetFloat( "gravity", 800.0f ); // main thread
+	// ...
+	// float gravity = rules.GetFloat( "gravity" ); // any thread
+	//
+	// Readers never lock or wait, they look at an immutable
+	// snapshot, and writers copy it, change the copy and publish
+	// it in one atomic swap, then wait for readers that may still
+	// be looking at the old one before freeing it (RCU-style)
+	//
+	// So writes are slow, and a thread must not write while it
+	// holds a Snapshot, or it will wait for itself forever
+	// ============================
+	class ConcurrentDictionary final
+	{
+	public:
+		// ============================
+		// ConcurrentDictionary::Snapshot
+		//
+		// The dictionary as it was when the snapshot was taken,
+		// it stays alive and unchanged until the snapshot goes
+		// away, so keep it short-lived, writers wait for it
+		// ============================
+		class Snapshot final
+		{
+		public:
+			Snapshot( Snapshot&& snapshot ) noexcept;
+			Snapshot( const Snapshot& snapshot ) = delete;
+			~Snapshot();
+
+			const Dictionary& operator*() const
+			{
+				return *dict;
+			}
+
+			const Dictionary* operator->() const
+			{
+				return dict;
+			}
+
+		private:
+			friend class ConcurrentDictionary;
+			Snapshot( std::atomic<uint32_t>* readers, const Dictionary* dict );
+
+			std::atomic<uint32_t>* readers{ nullptr };
+			const Dictionary* dict{ nullptr };
+		};
+
+		ConcurrentDictionary();
+		explicit ConcurrentDictionary( Dictionary dict );
+		ConcurrentDictionary( const ConcurrentDictionary& dict ) = delete;
+		// No snapshots may be alive by now
+		~ConcurrentDictionary();
+
+		// Never locks or waits
+		Snapshot	Read() const;
+
+		// Each of these looks at its own snapshot
+		std::string GetString( StringView keyname, const char* defaultValue = "" ) const;
+		float		GetFloat( StringView keyname, const float& defaultValue = 0.0f ) const;
+		int			GetInteger( StringView keyname, const int& defaultValue = 0 ) const;
+		bool		GetBool( StringView keyname, const bool& defaultValue = false ) const;
+		Vec3		GetVec3( StringView keyname, const Vec3& defaultValue = Vec3::Zero ) const;
+		bool		KeyExists( StringView keyname ) const;
+
+		// Each of these publishes a new version
+		void		SetString( StringView keyname, StringView value );
+		void		SetFloat( StringView keyname, float value );
+		void		SetInteger( StringView keyname, int value );
+		void		SetBool( StringView keyname, bool value );
+		void		SetVec3( StringView keyname, const Vec3& value );
+
+		// Makes several changes at once, readers see all or none of them
+		// Usage:
+		// rules.Update( []( Dictionary& dict )
+		// {
+		//		dict.SetFloat( "gravity", 400.0f );
+		//		dict.SetFloat( "friction", 2.0f );
+		// } );
+		template<typename EditFunction>
+		void		Update( EditFunction&& edit )
+		{
+			std::lock_guard<std::mutex> lock( writeMutex );
+			Dictionary edited = *current.load( std::memory_order_relaxed );
+			edit( edited );
+			Publish( std::move( edited ) );
+		}
+
+		// Swaps in a whole new dictionary
+		void		Replace( Dictionary dict );
+
+		// @returns How many times it was written to, taken together with a
+		// snapshot it tells readers whether anything changed since they last looked
+		uint64_t	GetVersion() const;
+
+	private:
+		// Must be called with writeMutex held
+		void		Publish( Dictionary&& dict );
+
+		// Readers are counted in one of several cache lines, picked per
+		// thread, so they don't all fight over the same one, and each line
+		// has a count per generation, which writers flip between
+		static constexpr size_t NumReaderStripes = 16U;
+		struct alignas( 64 ) ReaderStripe
+		{
+			std::atomic<uint32_t> readers[2]{};
+		};
+
+		mutable ReaderStripe stripes[NumReaderStripes];
+		std::atomic<uint32_t> generation{ 0U };
+		std::atomic<const Dictionary*> current{ nullptr };
+		std::atomic<uint64_t> version{ 0U };
+		std::mutex	writeMutex;
+	};
+}
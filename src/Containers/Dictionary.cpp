@@ -4,19 +4,233 @@
 #include "Precompiled.hpp"
 using namespace adm;
 
+DictionaryValue::DictionaryValue( StringView value )
+	: text( value )
+{
+}
+
+DictionaryValue::DictionaryValue( const char* value )
+	: text( nullptr != value ? value : "" )
+{
+}
+
+DictionaryValue::DictionaryValue( float value )
+	: number( value ), type( DictionaryTypes::Float ), textState( TextStates::Missing )
+{
+}
+
+DictionaryValue::DictionaryValue( int value )
+	: integer( value ), type( DictionaryTypes::Integer ), textState( TextStates::Missing )
+{
+}
+
+DictionaryValue::DictionaryValue( bool value )
+	: boolean( value ), type( DictionaryTypes::Boolean ), textState( TextStates::Missing )
+{
+}
+
+DictionaryValue::DictionaryValue( const Vec3& value )
+	: vector{ value.x, value.y, value.z }, type( DictionaryTypes::Vec3 ), textState( TextStates::Missing )
+{
+}
+
+DictionaryValue::DictionaryValue( const DictionaryValue& value )
+{
+	*this = value;
+}
+
+DictionaryValue::DictionaryValue( DictionaryValue&& value ) noexcept
+{
+	*this = std::move( value );
+}
+
+DictionaryValue& DictionaryValue::operator=( const DictionaryValue& value )
+{
+	if ( this == &value )
+	{
+		return *this;
+	}
+
+	CopyTyped( value );
+
+	// Another thread may be formatting its text right now,
+	// in which case the copy formats its own when needed
+	if ( value.textState.load( std::memory_order_acquire ) == TextStates::Ready )
+	{
+		text = value.text;
+		textState.store( TextStates::Ready, std::memory_order_relaxed );
+	}
+	else
+	{
+		text.clear();
+		textState.store( TextStates::Missing, std::memory_order_relaxed );
+	}
+
+	return *this;
+}
+
+DictionaryValue& DictionaryValue::operator=( DictionaryValue&& value ) noexcept
+{
+	if ( this == &value )
+	{
+		return *this;
+	}
+
+	CopyTyped( value );
+	text = std::move( value.text );
+	textState.store( value.textState.load( std::memory_order_relaxed ), std::memory_order_relaxed );
+
+	// Numbers can make their text again, strings are left empty
+	value.text.clear();
+	if ( value.type != DictionaryTypes::String )
+	{
+		value.textState.store( TextStates::Missing, std::memory_order_relaxed );
+	}
+
+	return *this;
+}
+
+void DictionaryValue::CopyTyped( const DictionaryValue& value )
+{
+	type = value.type;
+	switch ( type )
+	{
+	case DictionaryTypes::Float: number = value.number; break;
+	case DictionaryTypes::Integer: integer = value.integer; break;
+	case DictionaryTypes::Boolean: boolean = value.boolean; break;
+	case DictionaryTypes::Vec3: std::copy( value.vector, value.vector + 3, vector ); break;
+	default: break;
+	}
+}
+
+const String& DictionaryValue::GetString() const
+{
+	uint8_t state = textState.load( std::memory_order_acquire );
+	if ( state == TextStates::Ready )
+	{
+		return text;
+	}
+
+	// Several threads may be reading the same const value,
+	// the first one here formats it, the rest wait for it
+	if ( state != TextStates::Missing
+		|| !textState.compare_exchange_strong( state, TextStates::Formatting, std::memory_order_acquire ) )
+	{
+		while ( textState.load( std::memory_order_acquire ) != TextStates::Ready )
+		{
+			std::this_thread::yield();
+		}
+
+		return text;
+	}
+
+	char buffer[Vec3TextSize];
+	switch ( type )
+	{
+	case DictionaryTypes::Float: text.assign( buffer, WriteFloat( number, buffer, sizeof( buffer ) ) ); break;
+	case DictionaryTypes::Integer: text.assign( buffer, WriteInteger( integer, buffer, sizeof( buffer ) ) ); break;
+	case DictionaryTypes::Boolean: text = boolean ? "1" : "0"; break;
+	case DictionaryTypes::Vec3: text.assign( buffer, WriteFloats( vector, 3U, buffer, sizeof( buffer ) ) ); break;
+	default: break;
+	}
+
+	textState.store( TextStates::Ready, std::memory_order_release );
+	return text;
+}
+
+float DictionaryValue::GetFloat() const
+{
+	switch ( type )
+	{
+	case DictionaryTypes::Float: return number;
+	case DictionaryTypes::Integer: return float( integer );
+	case DictionaryTypes::Boolean: return boolean ? 1.0f : 0.0f;
+	case DictionaryTypes::Vec3: return vector[0];
+	default: return ParseFloat( text );
+	}
+}
+
+int DictionaryValue::GetInteger() const
+{
+	switch ( type )
+	{
+	case DictionaryTypes::Float: return int( number );
+	case DictionaryTypes::Integer: return integer;
+	case DictionaryTypes::Boolean: return boolean ? 1 : 0;
+	case DictionaryTypes::Vec3: return int( vector[0] );
+	default: return ParseInteger( text );
+	}
+}
+
+bool DictionaryValue::GetBool() const
+{
+	if ( type == DictionaryTypes::Boolean )
+	{
+		return boolean;
+	}
+
+	return GetInteger() != 0;
+}
+
+Vec3 DictionaryValue::GetVec3() const
+{
+	switch ( type )
+	{
+	case DictionaryTypes::Float: return Vec3( number, 0.0f, 0.0f );
+	case DictionaryTypes::Integer: return Vec3( float( integer ), 0.0f, 0.0f );
+	case DictionaryTypes::Boolean: return Vec3( boolean ? 1.0f : 0.0f, 0.0f, 0.0f );
+	case DictionaryTypes::Vec3: return Vec3( vector );
+	default:
+	{
+		Vec3 result;
+		ParseFloats( text, &result.x, 3U );
+		return result;
+	}
+	}
+}
+
+constexpr size_t MinimumSlots = 64U;
+
+static const DictionaryValue EmptyValue;
+
 Dictionary::Dictionary()
 {
 	Clear();
 }
 
+Dictionary::Dictionary( SharedPtr<const DictionarySchema> schema )
+	: schema( std::move( schema ) )
+{
+	if ( nullptr != this->schema )
+	{
+		schemaValues.resize( this->schema->GetNumKeys() );
+	}
+}
+
+Dictionary::Dictionary( SharedPtr<const Dictionary> parent )
+	: parent( std::move( parent ) )
+{
+	if ( nullptr != this->parent )
+	{
+		numInherited = this->parent->GetNumIndices();
+	}
+}
+
 Dictionary::Dictionary( Dictionary&& dict ) noexcept
 {
-	pairs = std::move( dict.pairs );
+	*this = std::move( dict );
 }
 
 Dictionary::Dictionary( const Dictionary& dict )
 {
+	parent = dict.parent;
+	numInherited = dict.numInherited;
+	overrides = dict.overrides;
+	schema = dict.schema;
+	schemaValues = dict.schemaValues;
 	pairs = dict.pairs;
+	inlineTags = dict.inlineTags;
+	slots = dict.slots;
 }
 
 Dictionary::~Dictionary()
@@ -24,168 +238,657 @@ Dictionary::~Dictionary()
 	Clear();
 }
 
-std::string Dictionary::GetString( const char* keyname, const char* defaultValue ) const
+Dictionary& Dictionary::operator=( Dictionary&& dict ) noexcept
+{
+	if ( this == &dict )
+	{
+		return *this;
+	}
+
+	parent = std::move( dict.parent );
+	numInherited = dict.numInherited;
+	overrides = std::move( dict.overrides );
+	schema = std::move( dict.schema );
+	schemaValues = std::move( dict.schemaValues );
+	pairs = std::move( dict.pairs );
+	inlineTags = dict.inlineTags;
+	slots = std::move( dict.slots );
+
+	// Otherwise it'd still think it has the parent's keys
+	dict.Clear();
+	return *this;
+}
+
+Dictionary& Dictionary::operator=( const Dictionary& dict )
 {
-	if ( !KeyExists( keyname ) )
+	if ( this != &dict )
+	{
+		*this = Dictionary( dict );
+	}
+
+	return *this;
+}
+
+std::string Dictionary::GetString( StringView keyname, const char* defaultValue ) const
+{
+	const DictionaryValue* value = FindValue( keyname );
+	if ( nullptr == value )
 	{
 		return defaultValue;
 	}
 
-	return pairs.at( keyname );
+	return value->GetString();
 }
 
-bool Dictionary::GetString( const char* keyname, std::string& out ) const
+bool Dictionary::GetString( StringView keyname, std::string& out ) const
 {
-	if ( !KeyExists( keyname ) )
+	const DictionaryValue* value = FindValue( keyname );
+	if ( nullptr == value )
 	{
 		return false;
 	}
 
-	out = pairs.at( keyname );
+	out = value->GetString();
 	return true;
 }
 
-void Dictionary::SetString( const char* keyname, std::string_view value )
+void Dictionary::SetString( StringView keyname, std::string_view value )
 {
-	pairs[keyname] = value;
+	FindOrAdd( keyname ) = value;
 }
 
-const char* Dictionary::GetCString( const char* keyname, const char* defaultValue ) const
+const char* Dictionary::GetCString( StringView keyname, const char* defaultValue ) const
 {
-	if ( !KeyExists( keyname ) )
+	const DictionaryValue* value = FindValue( keyname );
+	if ( nullptr == value )
 	{
 		return defaultValue;
 	}
 
-	return pairs.at( keyname ).c_str();
+	return value->GetString().c_str();
 }
 
-bool Dictionary::GetCString( const char* keyname, char* out, int length ) const
+bool Dictionary::GetCString( StringView keyname, char* out, int length ) const
 {
-	if ( !KeyExists( keyname ) )
+	const DictionaryValue* value = FindValue( keyname );
+	if ( nullptr == value )
 	{
 		return false;
 	}
 
-	strncpy( out, GetStringDirect( keyname ), length );
+	strncpy( out, value->GetString().c_str(), length );
 	return true;
 }
 
-void Dictionary::SetCString( const char* keyname, const char* value )
+void Dictionary::SetCString( StringView keyname, const char* value )
 {
-	pairs[keyname] = value;
+	FindOrAdd( keyname ) = value;
 }
 
-float Dictionary::GetFloat( const char* keyname, const float& defaultValue ) const
+float Dictionary::GetFloat( StringView keyname, const float& defaultValue ) const
 {
-	if ( !KeyExists( keyname ) )
+	const DictionaryValue* value = FindValue( keyname );
+	if ( nullptr == value )
 	{
 		return defaultValue;
 	}
 
-	return std::atof( GetStringDirect( keyname ) );
+	return value->GetFloat();
 }
 
-bool Dictionary::GetFloat( const char* keyname, float& out ) const
+bool Dictionary::GetFloat( StringView keyname, float& out ) const
 {
-	if ( !KeyExists( keyname ) )
+	const DictionaryValue* value = FindValue( keyname );
+	if ( nullptr == value )
 	{
 		return false;
 	}
 
-	out = std::atof( GetStringDirect( keyname ) );
+	out = value->GetFloat();
 	return true;
 }
 
-void Dictionary::SetFloat( const char* keyname, float value )
+void Dictionary::SetFloat( StringView keyname, float value )
 {
-	pairs[keyname] = std::to_string( value );
+	FindOrAdd( keyname ) = value;
 }
 
-int Dictionary::GetInteger( const char* keyname, const int& defaultValue ) const
+int Dictionary::GetInteger( StringView keyname, const int& defaultValue ) const
 {
-	if ( !KeyExists( keyname ) )
+	const DictionaryValue* value = FindValue( keyname );
+	if ( nullptr == value )
 	{
 		return defaultValue;
 	}
 
-	return std::atoi( GetStringDirect( keyname ) );
+	return value->GetInteger();
 }
 
-bool Dictionary::GetInteger( const char* keyname, int& out ) const
+bool Dictionary::GetInteger( StringView keyname, int& out ) const
 {
-	if ( !KeyExists( keyname ) )
+	const DictionaryValue* value = FindValue( keyname );
+	if ( nullptr == value )
 	{
 		return false;
 	}
 
-	out = std::atoi( GetStringDirect( keyname ) );
+	out = value->GetInteger();
 	return true;
 }
 
-void Dictionary::SetInteger( const char* keyname, int value )
+void Dictionary::SetInteger( StringView keyname, int value )
 {
-	SetString( keyname, std::to_string( value ) );
+	FindOrAdd( keyname ) = value;
 }
 
-bool Dictionary::GetBool( const char* keyname, const bool& defaultValue ) const
+bool Dictionary::GetBool( StringView keyname, const bool& defaultValue ) const
 {
-	if ( !KeyExists( keyname ) )
+	const DictionaryValue* value = FindValue( keyname );
+	if ( nullptr == value )
 	{
 		return defaultValue;
 	}
 
-	return std::atoi( GetStringDirect( keyname ) ) == 0;
+	return value->GetBool();
 }
 
-bool Dictionary::GetBool( const char* keyname, bool& out ) const
+bool Dictionary::GetBool( StringView keyname, bool& out ) const
 {
-	if ( !KeyExists( keyname ) )
+	const DictionaryValue* value = FindValue( keyname );
+	if ( nullptr == value )
 	{
 		return false;
 	}
 
-	out = std::atoi( GetStringDirect( keyname ) ) != 0;
+	out = value->GetBool();
 	return true;
 }
 
-void Dictionary::SetBool( const char* keyname, bool value )
+void Dictionary::SetBool( StringView keyname, bool value )
 {
-	SetCString( keyname, value ? "1" : "0" );
+	FindOrAdd( keyname ) = value;
 }
 
-Vec3 Dictionary::GetVec3( const char* keyname, const Vec3& defaultValue ) const
+Vec3 Dictionary::GetVec3( StringView keyname, const Vec3& defaultValue ) const
 {
-	if ( !KeyExists( keyname ) )
+	const DictionaryValue* value = FindValue( keyname );
+	if ( nullptr == value )
 	{
 		return defaultValue;
 	}
 
-	return Vec3( GetStringDirect( keyname ) );
+	return value->GetVec3();
 }
 
-bool Dictionary::GetVec3( const char* keyname, Vec3& out ) const
+bool Dictionary::GetVec3( StringView keyname, Vec3& out ) const
 {
-	if ( !KeyExists( keyname ) )
+	const DictionaryValue* value = FindValue( keyname );
+	if ( nullptr == value )
 	{
 		return false;
 	}
 
-	out = Vec3( GetStringDirect( keyname ) );
+	out = value->GetVec3();
 	return true;
 }
 
-void Dictionary::SetVec3( const char* keyname, const Vec3& value )
+void Dictionary::SetVec3( StringView keyname, const Vec3& value )
 {
-	pairs[keyname] = std::to_string( value );
+	FindOrAdd( keyname ) = value;
 }
 
-bool Dictionary::KeyExists( const char* keyname ) const
+bool Dictionary::KeyExists( StringView keyname ) const
 {
-	return pairs.find( keyname ) != pairs.end();
+	return nullptr != FindValue( keyname );
 }
 
 void Dictionary::Clear()
 {
+	parent.reset();
+	numInherited = 0U;
+	overrides.clear();
+	schema.reset();
+	schemaValues.clear();
 	pairs.clear();
+	slots.clear();
+}
+
+size_t Dictionary::GetNumKeys() const
+{
+	size_t numKeys = pairs.size();
+	for ( const Optional<DictionaryValue>& value : schemaValues )
+	{
+		numKeys += value.has_value() ? 1U : 0U;
+	}
+
+	if ( nullptr != parent )
+	{
+		// Overrides of keys the parent doesn't have a value for count too
+		numKeys += parent->GetNumKeys();
+		for ( size_t i = 0U; i < overrides.size(); i++ )
+		{
+			numKeys += nullptr == parent->ValueAt( overrides[i].first ) ? 1U : 0U;
+		}
+	}
+
+	return numKeys;
+}
+
+const SharedPtr<const DictionarySchema>& Dictionary::GetSchema() const
+{
+	return schema;
+}
+
+const SharedPtr<const Dictionary>& Dictionary::GetParent() const
+{
+	return parent;
+}
+
+bool Dictionary::ParseFrom( Lexer& lexer )
+{
+	const Token open = lexer.NextToken( true );
+	if ( open.kind != TokenKinds::Delimiter || open.text != "{" )
+	{
+		return false;
+	}
+
+	while ( true )
+	{
+		const Token key = lexer.NextToken( true );
+		if ( key.kind == TokenKinds::Delimiter && key.text == "}" )
+		{
+			return true;
+		}
+
+		// Anything other than a closing brace is out of place, and the
+		// rest would be out of step with the blocks, e.g. nested ones
+		if ( key.IsEndOfFile() || key.kind == TokenKinds::Delimiter )
+		{
+			return false;
+		}
+
+		// Views from streaming lexers don't outlive the next token,
+		// so the key is copied out, and moved in if it's new
+		String keyname( key.text );
+		const Token value = lexer.NextToken( true );
+		if ( value.IsEndOfFile() || value.kind == TokenKinds::Delimiter )
+		{
+			return false;
+		}
+
+		const StringView keyView = keyname;
+		FindOrAdd( keyView, std::move( keyname ) ) = DictionaryValue( value.text );
+	}
+}
+
+size_t Dictionary::ParseAll( Lexer& lexer, Vector<Dictionary>& pool )
+{
+	const size_t oldSize = pool.size();
+	while ( !lexer.Peek( 0U, true ).IsEndOfFile() )
+	{
+		Dictionary& dict = pool.emplace_back();
+		if ( !dict.ParseFrom( lexer ) )
+		{
+			pool.pop_back();
+			break;
+		}
+	}
+
+	return pool.size() - oldSize;
+}
+
+Dictionary::Handle Dictionary::Find( StringView keyname ) const
+{
+	Handle handle;
+	if ( nullptr != schema )
+	{
+		handle = schema->Find( keyname );
+		if ( handle.IsValid() )
+		{
+			handle.index += uint32_t( numInherited );
+			return handle;
+		}
+	}
+
+	// Pairs come after the parent's keys and the schema's values
+	const size_t pairsStart = numInherited + schemaValues.size();
+	if ( slots.empty() )
+	{
+		const size_t index = FindInline( keyname );
+		if ( index < pairs.size() )
+		{
+			handle.index = uint32_t( pairsStart + index );
+			return handle;
+		}
+	}
+	else
+	{
+		const size_t slot = FindSlot( keyname, Hash( keyname ) );
+		if ( slots[slot].index != 0U )
+		{
+			handle.index = uint32_t( pairsStart + slots[slot].index - 1U );
+			return handle;
+		}
+	}
+
+	// Overridden or not, inherited keys keep the parent's handles
+	if ( nullptr != parent )
+	{
+		handle = parent->Find( keyname );
+	}
+
+	return handle;
+}
+
+const DictionaryValue& Dictionary::GetValue( Handle handle ) const
+{
+	const DictionaryValue* value = ValueAt( handle.index );
+	return nullptr != value ? *value : EmptyValue;
+}
+
+void Dictionary::SetValue( Handle handle, DictionaryValue value )
+{
+	if ( handle.index < GetNumIndices() )
+	{
+		MutableValueAt( handle.index ) = std::move( value );
+	}
+}
+
+const Dictionary::Entry& Dictionary::Iterator::operator*() const
+{
+	return entry.emplace( dict->KeyAt( index ), *dict->ValueAt( index ) );
+}
+
+uint32_t Dictionary::Hash( StringView keyname )
+{
+	return uint32_t( std::hash<StringView>()( keyname ) );
+}
+
+// Length, first and last character, enough to tell most keys apart
+uint32_t Dictionary::Tag( StringView keyname )
+{
+	if ( keyname.empty() )
+	{
+		return 0U;
+	}
+
+	return uint32_t( keyname.size() ) << 16U | uint32_t( uint8_t( keyname.front() ) ) << 8U | uint8_t( keyname.back() );
+}
+
+// @returns The index of the pair, or the number of pairs if it isn't there
+size_t Dictionary::FindInline( StringView keyname ) const
+{
+	const uint32_t tag = Tag( keyname );
+	const size_t numPairs = pairs.size();
+	for ( size_t i = 0U; i < numPairs; i++ )
+	{
+		if ( inlineTags[i] == tag && pairs[i].first == keyname )
+		{
+			return i;
+		}
+	}
+
+	return numPairs;
+}
+
+// Finds the slot the key is in, or the empty slot it would go into
+size_t Dictionary::FindSlot( StringView keyname, uint32_t hash ) const
+{
+	const size_t mask = slots.size() - 1U;
+	size_t slot = hash & mask;
+
+	while ( slots[slot].index != 0U )
+	{
+		if ( slots[slot].hash == hash && pairs[slots[slot].index - 1U].first == keyname )
+		{
+			break;
+		}
+
+		slot = (slot + 1U) & mask;
+	}
+
+	return slot;
+}
+
+const DictionaryValue* Dictionary::FindValue( StringView keyname ) const
+{
+	const Handle handle = Find( keyname );
+	return handle.IsValid() ? ValueAt( handle.index ) : nullptr;
+}
+
+size_t Dictionary::GetNumIndices() const
+{
+	return numInherited + schemaValues.size() + pairs.size();
+}
+
+size_t Dictionary::SkipUnset( size_t index ) const
+{
+	const size_t numIndices = GetNumIndices();
+	while ( index < numIndices && nullptr == ValueAt( index ) )
+	{
+		index++;
+	}
+
+	return index;
+}
+
+StringView Dictionary::KeyAt( size_t index ) const
+{
+	if ( index < numInherited )
+	{
+		return parent->KeyAt( index );
+	}
+
+	index -= numInherited;
+	if ( index < schemaValues.size() )
+	{
+		return schema->GetKey( index );
+	}
+
+	return pairs[index - schemaValues.size()].first;
+}
+
+const DictionaryValue* Dictionary::ValueAt( size_t index ) const
+{
+	if ( index < numInherited )
+	{
+		// There's only ever a few of these
+		for ( size_t i = 0U; i < overrides.size(); i++ )
+		{
+			if ( overrides[i].first == index )
+			{
+				return &overrides[i].second;
+			}
+		}
+
+		return parent->ValueAt( index );
+	}
+
+	index -= numInherited;
+	if ( index < schemaValues.size() )
+	{
+		return schemaValues[index].has_value() ? &*schemaValues[index] : nullptr;
+	}
+
+	index -= schemaValues.size();
+	return index < pairs.size() ? &pairs[index].second : nullptr;
+}
+
+// The index must be valid, inherited values get overridden
+DictionaryValue& Dictionary::MutableValueAt( size_t index )
+{
+	if ( index < numInherited )
+	{
+		for ( size_t i = 0U; i < overrides.size(); i++ )
+		{
+			if ( overrides[i].first == index )
+			{
+				return overrides[i].second;
+			}
+		}
+
+		return overrides.emplace_back( index, DictionaryValue() ).second;
+	}
+
+	index -= numInherited;
+	if ( index < schemaValues.size() )
+	{
+		Optional<DictionaryValue>& value = schemaValues[index];
+		return value.has_value() ? *value : value.emplace();
+	}
+
+	return pairs[index - schemaValues.size()].second;
+}
+
+DictionaryValue& Dictionary::FindOrAdd( StringView keyname, String&& ownedKey )
+{
+	if ( nullptr != schema )
+	{
+		const Handle handle = schema->Find( keyname );
+		if ( handle.IsValid() )
+		{
+			return MutableValueAt( numInherited + handle.index );
+		}
+	}
+
+	if ( nullptr != parent )
+	{
+		const Handle handle = parent->Find( keyname );
+		if ( handle.IsValid() )
+		{
+			return MutableValueAt( handle.index );
+		}
+	}
+
+	if ( slots.empty() )
+	{
+		const size_t index = FindInline( keyname );
+		if ( index < pairs.size() )
+		{
+			return pairs[index].second;
+		}
+
+		if ( pairs.size() < InlineSize )
+		{
+			inlineTags[pairs.size()] = Tag( keyname );
+			return Add( keyname, std::move( ownedKey ) );
+		}
+
+		// Too many to go through one by one
+		Grow();
+	}
+
+	const uint32_t hash = Hash( keyname );
+	size_t slot = FindSlot( keyname, hash );
+	if ( slots[slot].index != 0U )
+	{
+		return pairs[slots[slot].index - 1U].second;
+	}
+
+	// Keep the index at most 3/4 full, so probes stay short
+	if ( (pairs.size() + 1U) * 4U > slots.size() * 3U )
+	{
+		Grow();
+		slot = FindSlot( keyname, hash );
+	}
+
+	slots[slot] = { uint32_t( pairs.size() + 1U ), hash };
+	return Add( keyname, std::move( ownedKey ) );
+}
+
+DictionaryValue& Dictionary::Add( StringView keyname, String&& ownedKey )
+{
+	if ( ownedKey.empty() )
+	{
+		pairs.emplace_back( String( keyname ), DictionaryValue() );
+	}
+	else
+	{
+		pairs.emplace_back( std::move( ownedKey ), DictionaryValue() );
+	}
+
+	return pairs.back().second;
+}
+
+// Doubles the slots, the hashes are kept in them so nothing is hashed again
+// The first time around, the index is built from the inline pairs
+void Dictionary::Grow()
+{
+	if ( slots.empty() )
+	{
+		slots.assign( MinimumSlots, Slot{ 0U, 0U } );
+		for ( size_t i = 0U; i < pairs.size(); i++ )
+		{
+			const uint32_t hash = Hash( pairs[i].first );
+			slots[FindSlot( pairs[i].first, hash )] = { uint32_t( i + 1U ), hash };
+		}
+
+		return;
+	}
+
+	Vector<Slot> oldSlots( slots.size() * 2U, Slot{ 0U, 0U } );
+	oldSlots.swap( slots );
+
+	const size_t mask = slots.size() - 1U;
+	for ( const Slot& old : oldSlots )
+	{
+		if ( old.index == 0U )
+		{
+			continue;
+		}
+
+		size_t slot = old.hash & mask;
+		while ( slots[slot].index != 0U )
+		{
+			slot = (slot + 1U) & mask;
+		}
+
+		slots[slot] = old;
+	}
+}
+
+DictionarySchema::DictionarySchema( std::initializer_list<StringView> keynames )
+{
+	for ( const StringView& keyname : keynames )
+	{
+		keys.Intern( keyname );
+	}
+}
+
+DictionarySchema::DictionarySchema( const Vector<StringView>& keynames )
+{
+	for ( const StringView& keyname : keynames )
+	{
+		keys.Intern( keyname );
+	}
+}
+
+DictionarySchema::DictionarySchema( const Dictionary& prototype )
+{
+	for ( const auto& [keyname, value] : prototype )
+	{
+		keys.Intern( keyname );
+	}
+}
+
+Dictionary::Handle DictionarySchema::Find( StringView keyname ) const
+{
+	Dictionary::Handle handle;
+	const SymbolId id = keys.Find( keyname );
+	if ( id != InvalidSymbol )
+	{
+		handle.index = id;
+	}
+
+	return handle;
+}
+
+StringView DictionarySchema::GetKey( size_t index ) const
+{
+	return keys.GetName( SymbolId( index ) );
+}
+
+size_t DictionarySchema::GetNumKeys() const
+{
+	return keys.GetCount();
 }
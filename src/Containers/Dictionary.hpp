@@ -6,8 +6,104 @@
 namespace adm
 {
 	class Vec3;
+	class DictionarySchema;
+
+	struct DictionaryTypes
+	{
+		enum Type : uint8_t
+		{
+			String,
+			Float,
+			Integer,
+			// Not "Bool", X11 has a macro by that name
+			Boolean,
+			Vec3
+		};
+	};
+
+	// ============================
+	// DictionaryValue
+	// 
+	// A dictionary value, kept in the type it was set as,
+	// so reading it back doesn't have to parse anything
+	// Reading it as another type converts it the same way
+	// it'd be converted from text, e.g. a Vec3 read as a
+	// float gives its X, and text is only made on demand,
+	// by whichever thread asks for it first
+	// ============================
+	class DictionaryValue final
+	{
+	public:
+		DictionaryValue() = default;
+		DictionaryValue( StringView value );
+		DictionaryValue( const char* value );
+		DictionaryValue( float value );
+		DictionaryValue( int value );
+		DictionaryValue( bool value );
+		DictionaryValue( const adm::Vec3& value );
+		DictionaryValue( const DictionaryValue& value );
+		DictionaryValue( DictionaryValue&& value ) noexcept;
+
+		DictionaryValue& operator=( const DictionaryValue& value );
+		DictionaryValue& operator=( DictionaryValue&& value ) noexcept;
+
+		DictionaryTypes::Type GetType() const
+		{
+			return type;
+		}
+
+		// The value as text, numbers are only formatted the first time
+		// Like the other getters, it can be called from several threads
+		// at once, the others wait while the first one formats it
+		// The reference stays valid until the value is changed
+		// (in a Dictionary, until it's changed or the dictionary is cleared)
+		const String& GetString() const;
+		float		GetFloat() const;
+		int			GetInteger() const;
+		bool		GetBool() const;
+		adm::Vec3	GetVec3() const;
+
+		operator const String&() const
+		{
+			return GetString();
+		}
+
+		operator StringView() const
+		{
+			return GetString();
+		}
+
+	private:
+		struct TextStates
+		{
+			enum Type : uint8_t
+			{
+				Missing,
+				Formatting,
+				Ready
+			};
+		};
+
+		void		CopyTyped( const DictionaryValue& value );
+
+		union
+		{
+			float	number{ 0.0f };
+			int		integer;
+			bool	boolean;
+			float	vector[3];
+		};
+
+		DictionaryTypes::Type type{ DictionaryTypes::String };
+		// String values always have their text
+		mutable std::atomic<uint8_t> textState{ TextStates::Ready };
+		mutable String text;
+	};
 
 	/*
+		Values are stored in the type they're set as, text is only
+		produced when a value is read as a string or iterated over
+
 		Example usage:
 		Dictionary dict;
 		dict.SetFloat( "health", 100.0f );
@@ -28,82 +124,261 @@ namespace adm
 		{
 			float health = dict.GetHealth( "health" );
 		}
+
+		Instances can inherit from a template, storing only what they change:
+		auto door = std::make_shared<const Dictionary>( MakeDoor() );
+		Dictionary instance( door );
+		instance.SetString( "targetname", "door_12" );
+
+		Entities of the same class can share their keys:
+		auto schema = std::make_shared<DictionarySchema>( std::initializer_list<StringView>{ "health", "origin" } );
+		const Dictionary::Handle health = schema->Find( "health" );
+
+		Dictionary dict( schema );
+		dict.SetValue( health, 100.0f );
 	*/
 
 	// ============================
 	// Game entity dictionary for keyvalues
+	// 
+	// Pairs are kept in the order they were added, and keys
+	// never have to become std::strings to be looked up
+	// Up to InlineSize pairs are simply searched one by one,
+	// comparing the lengths and ends of the keys, which are
+	// kept inside the dictionary itself, so small ones don't
+	// hash anything, past that an index is built over them
+	//
+	// With a DictionarySchema, the schema's keys are not stored
+	// in the dictionary at all, just an array of their values,
+	// and any other keys go into the pairs like they usually do
+	//
+	// With a parent, the parent's pairs aren't copied, the keys
+	// that get set are kept as overrides, and the rest is read
+	// from the parent, so making one costs nothing per key
+	//
+	// Values never move once they're added, so what GetCString,
+	// GetString and operator[] give stays valid as more keys are
+	// added, and when the dictionary is moved, until the value is
+	// changed or the dictionary is cleared
+	//
+	// Like with the standard containers, any number of threads can
+	// read a dictionary at once as long as nobody changes it, and
+	// that includes a parent shared between instances
 	// ============================
 	class Dictionary final
 	{
 	public:
-		using DictionaryMap = Map<String, String>;
+		using Pair = std::pair<String, DictionaryValue>;
+		// Only the index over the pairs gets rebuilt as they're added, never the pairs
+		using PairList = StableVector<Pair>;
+		// What iterating gives, the key is valid as long as the dictionary is
+		using Entry = std::pair<StringView, const DictionaryValue&>;
+
+		// Most entities have fewer keys than this
+		static constexpr size_t InlineSize = 16U;
+
+		// A key that was looked up with Find, reading through it skips the
+		// hashing and probing, it stays valid as more keys are added, in
+		// copies of the dictionary too, until the dictionary is cleared
+		// Handles from a DictionarySchema work with all of its dictionaries
+		struct Handle
+		{
+			uint32_t index{ ~uint32_t( 0 ) };
+
+			bool IsValid() const
+			{
+				return index != ~uint32_t( 0 );
+			}
+		};
+
+		class Iterator final
+		{
+		public:
+			Iterator( const Dictionary& dict, size_t index )
+				: dict( &dict ), index( dict.SkipUnset( index ) )
+			{
+			}
+
+			// The entry is kept in the iterator, so loops can take it by reference
+			const Entry& operator*() const;
+
+			Iterator& operator++()
+			{
+				index = dict->SkipUnset( index + 1U );
+				return *this;
+			}
+
+			bool operator==( const Iterator& other ) const
+			{
+				return index == other.index;
+			}
+
+			bool operator!=( const Iterator& other ) const
+			{
+				return index != other.index;
+			}
+
+		private:
+			const Dictionary* dict;
+			size_t index;
+			mutable Optional<Entry> entry;
+		};
 
 		Dictionary();
+		// Has room for the schema's keys, none of them are set until a value is given
+		explicit Dictionary( SharedPtr<const DictionarySchema> schema );
+		// Starts out with all of the parent's keys and values, which it
+		// keeps referring to, so the parent must not change afterwards
+		// Handles from the parent work with this dictionary too
+		explicit Dictionary( SharedPtr<const Dictionary> parent );
+		// The moved-from dictionary is left empty
 		Dictionary( Dictionary&& dict ) noexcept;
 		Dictionary( const Dictionary& dict );
 		~Dictionary();
 
+		Dictionary& operator=( Dictionary&& dict ) noexcept;
+		Dictionary& operator=( const Dictionary& dict );
+
 		// C++ strings
-		std::string GetString( const char* keyname, const char* defaultValue = "" ) const;
-		bool 		GetString( const char* keyname, std::string& out ) const;
-		void 		SetString( const char* keyname, std::string_view value );
+		std::string GetString( StringView keyname, const char* defaultValue = "" ) const;
+		bool 		GetString( StringView keyname, std::string& out ) const;
+		void 		SetString( StringView keyname, std::string_view value );
 		// C strings
-		const char* GetCString( const char* keyname, const char* defaultValue = "" ) const;
-		bool 		GetCString( const char* keyname, char* out, int length ) const;
-		void 		SetCString( const char* keyname, const char* value );
+		const char* GetCString( StringView keyname, const char* defaultValue = "" ) const;
+		bool 		GetCString( StringView keyname, char* out, int length ) const;
+		void 		SetCString( StringView keyname, const char* value );
 		// Floats
-		float 		GetFloat( const char* keyname, const float& defaultValue = 0.0f ) const;
-		bool 		GetFloat( const char* keyname, float& out ) const;
-		void 		SetFloat( const char* keyname, float value );
+		float 		GetFloat( StringView keyname, const float& defaultValue = 0.0f ) const;
+		bool 		GetFloat( StringView keyname, float& out ) const;
+		void 		SetFloat( StringView keyname, float value );
 		// Integers
-		int 		GetInteger( const char* keyname, const int& defaultValue = 0 ) const;
-		bool 		GetInteger( const char* keyname, int& out ) const;
-		void 		SetInteger( const char* keyname, int value ) ;
+		int 		GetInteger( StringView keyname, const int& defaultValue = 0 ) const;
+		bool 		GetInteger( StringView keyname, int& out ) const;
+		void 		SetInteger( StringView keyname, int value ) ;
 		// Booleans
-		bool 		GetBool( const char* keyname, const bool& defaultValue = false ) const;
-		bool 		GetBool( const char* keyname, bool& out ) const;
-		void 		SetBool( const char* keyname, bool value );
+		bool 		GetBool( StringView keyname, const bool& defaultValue = false ) const;
+		bool 		GetBool( StringView keyname, bool& out ) const;
+		void 		SetBool( StringView keyname, bool value );
 		// Vec3
-		Vec3		GetVec3( const char* keyname, const Vec3& defaultValue = Vec3::Zero ) const;
-		bool		GetVec3( const char* keyname, Vec3& out ) const;
-		void		SetVec3( const char* keyname, const Vec3& value );
+		Vec3		GetVec3( StringView keyname, const Vec3& defaultValue = Vec3::Zero ) const;
+		bool		GetVec3( StringView keyname, Vec3& out ) const;
+		void		SetVec3( StringView keyname, const Vec3& value );
 		// Does this key exist?
-		bool		KeyExists( const char* keyname ) const;
-		// Clears all keyvalue pairs
+		bool		KeyExists( StringView keyname ) const;
+		// Clears all keyvalue pairs, the schema and the parent, invalidating all handles
 		void		Clear();
+		// @returns How many keys there are, including the parent's and the schema's ones that are set
+		size_t		GetNumKeys() const;
+		const SharedPtr<const DictionarySchema>& GetSchema() const;
+		const SharedPtr<const Dictionary>& GetParent() const;
 
-		StringView operator[] ( const char* keyname )
-		{
-			return pairs[keyname];
-		}
+		// Parses a { "key" "value" ... } block, adding its pairs, keys
+		// that are already there are overwritten, values are kept as text
+		// Keys and values can't be delimiters, so blocks can't be nested
+		// @returns False if there is no block, it is cut short, or it
+		// has a delimiter where a key or value should be, in which
+		// case the pairs before that are still added
+		bool		ParseFrom( Lexer& lexer );
+		// Parses blocks until the end of the text, or until one of
+		// them can't be parsed, adding a dictionary per block to the pool
+		// @returns How many dictionaries were added
+		static size_t ParseAll( Lexer& lexer, Vector<Dictionary>& pool );
 
-		DictionaryMap::iterator begin()
-		{
-			return pairs.begin();
-		}
+		// @returns A handle to the key, which isn't valid if there is no such key
+		Handle		Find( StringView keyname ) const;
+		// @returns The value behind the handle, or an empty one if it isn't valid
+		const DictionaryValue& GetValue( Handle handle ) const;
+		// Does nothing if the handle isn't valid
+		void		SetValue( Handle handle, DictionaryValue value );
 
-		DictionaryMap::const_iterator begin() const
+		StringView operator[] ( StringView keyname )
 		{
-			return pairs.begin();
+			return FindOrAdd( keyname ).GetString();
 		}
 
-		DictionaryMap::iterator end()
+		// The parent's keys come first, then the schema's, then the rest in the order they were added
+		// Entries are read-only, values are changed through handles instead, e.g. where
+		// for ( auto& [key, value] : dict ) value = "0"; used to write through the iterator:
+		// for ( const auto& [key, value] : dict ) dict.SetValue( dict.Find( key ), "0" );
+		// Don't add keys while iterating
+		Iterator	begin() const
 		{
-			return pairs.end();
+			return Iterator( *this, 0U );
 		}
-		
-		DictionaryMap::const_iterator end() const
+
+		Iterator	end() const
 		{
-			return pairs.end();
+			return Iterator( *this, GetNumIndices() );
 		}
 
-
 	private:
-		inline const char* GetStringDirect( const char* keyname ) const
+		struct Slot
 		{
-			return pairs.at( keyname ).c_str();
-		}
+			// Index of the pair + 1, 0 means empty
+			uint32_t		index;
+			uint32_t		hash;
+		};
+
+		static uint32_t	Hash( StringView keyname );
+		static uint32_t	Tag( StringView keyname );
+		size_t			FindInline( StringView keyname ) const;
+		size_t			FindSlot( StringView keyname, uint32_t hash ) const;
+		const DictionaryValue* FindValue( StringView keyname ) const;
+		// @returns How far handles go, unset schema keys included
+		size_t			GetNumIndices() const;
+		// @returns The index, or the next one after it that has a value
+		size_t			SkipUnset( size_t index ) const;
+		StringView		KeyAt( size_t index ) const;
+		const DictionaryValue* ValueAt( size_t index ) const;
+		DictionaryValue& MutableValueAt( size_t index );
+		// If the key is added, ownedKey is moved in, unless it's empty
+		DictionaryValue& FindOrAdd( StringView keyname, String&& ownedKey = String() );
+		DictionaryValue& Add( StringView keyname, String&& ownedKey );
+		void			Grow();
+
+		// Handles below numInherited refer to the parent's keys,
+		// overridden ones are looked for in the overrides first
+		SharedPtr<const Dictionary> parent;
+		size_t			numInherited{ 0 };
+		// Instances usually override a handful of their parent's keys
+		StableVector<std::pair<size_t, DictionaryValue>, 4U> overrides;
+
+		// One value per schema key, handles to pairs come after these
+		// Keys without a value act as if they weren't there
+		SharedPtr<const DictionarySchema> schema;
+		Vector<Optional<DictionaryValue>> schemaValues;
+
+		PairList		pairs;
+		// Tags of the first InlineSize pairs
+		Array<uint32_t, InlineSize> inlineTags{};
+		// Only built past InlineSize pairs
+		Vector<Slot>	slots;
+	};
 
-		DictionaryMap pairs;
-};
+	// ============================
+	// DictionarySchema
+	//
+	// A set of keys shared by many dictionaries, e.g. all
+	// entities of one class, which then only store values
+	// Its handles are indices into those values, so they
+	// can be resolved once and used with every dictionary
+	// The keys can't change once it's made
+	// ============================
+	class DictionarySchema final
+	{
+	public:
+		DictionarySchema( std::initializer_list<StringView> keynames );
+		DictionarySchema( const Vector<StringView>& keynames );
+		// Takes the keys of an existing dictionary, e.g. the first entity of a class
+		explicit DictionarySchema( const Dictionary& prototype );
+
+		// @returns A handle to the key, which isn't valid if the schema doesn't have it
+		Dictionary::Handle Find( StringView keyname ) const;
+		StringView	GetKey( size_t index ) const;
+		size_t		GetNumKeys() const;
+
+	private:
+		// Symbol IDs double as the indices of the values
+		SymbolTable	keys;
+	};
 }
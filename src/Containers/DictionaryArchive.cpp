@@ -0,0 +1,511 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#include "Precompiled.hpp"
+using namespace adm;
+
+// The archive, in order:
+// - ArchiveHeader
+// - ArchiveRecord for every dictionary, its pairs are a range in the pair array
+// - Pair for every keyvalue pair
+// - ArchiveString for every unique string, keys and values alike
+// - String hash table, each slot is a string ID + 1, 0 means empty
+// - The characters of all strings, each one null-terminated
+// The checksum covers all of it, except for the two checksums, and
+// the header checksum covers the rest of the header, checksum included
+struct ArchiveHeader
+{
+	char		magic[4];
+	uint32_t	version;
+	uint32_t	numDictionaries;
+	uint32_t	numPairs;
+	uint32_t	numStrings;
+	uint32_t	numSlots;
+	uint32_t	dataSize;
+	uint32_t	checksum;
+	uint32_t	headerChecksum;
+};
+
+struct ArchiveRecord
+{
+	uint32_t	firstPair;
+	uint32_t	numPairs;
+};
+
+struct DictionaryView::Pair
+{
+	SymbolId	key;
+	SymbolId	text;
+	float		number;
+	int32_t		integer;
+	float		vector[3];
+	uint8_t		type;
+	uint8_t		boolean;
+	uint8_t		padding[2];
+};
+
+struct ArchiveString
+{
+	uint32_t	offset;
+	uint32_t	length;
+};
+
+using Pair = DictionaryView::Pair;
+
+static_assert( sizeof( ArchiveHeader ) == 36U );
+static_assert( sizeof( Pair ) == 32U );
+
+constexpr char ArchiveMagic[4] = { 'A', 'D', 'M', 'D' };
+constexpr uint32_t MinimumArchiveSlots = 16U;
+
+// FNV-1a over 32-bit words, a single flipped bit always changes it
+static uint32_t Checksum( uint32_t hash, const uint8_t* data, size_t size )
+{
+	size_t i = 0U;
+	for ( ; i + sizeof( uint32_t ) <= size; i += sizeof( uint32_t ) )
+	{
+		uint32_t word;
+		std::memcpy( &word, data + i, sizeof( word ) );
+		hash = (hash ^ word) * 16777619U;
+	}
+
+	for ( ; i < size; i++ )
+	{
+		hash = (hash ^ data[i]) * 16777619U;
+	}
+
+	return hash;
+}
+
+static uint32_t ArchiveChecksum( const uint8_t* data, size_t size )
+{
+	const uint32_t headerHash = Checksum( 2166136261U, data, offsetof( ArchiveHeader, checksum ) );
+	return Checksum( headerHash, data + sizeof( ArchiveHeader ), size - sizeof( ArchiveHeader ) );
+}
+
+static uint32_t HeaderChecksum( const uint8_t* data )
+{
+	return Checksum( 2166136261U, data, offsetof( ArchiveHeader, headerChecksum ) );
+}
+
+// How big the archive says it is
+static uint64_t ArchiveSize( const ArchiveHeader& header )
+{
+	return sizeof( ArchiveHeader )
+		+ uint64_t( header.numDictionaries ) * sizeof( ArchiveRecord )
+		+ uint64_t( header.numPairs ) * sizeof( Pair )
+		+ uint64_t( header.numStrings ) * sizeof( ArchiveString )
+		+ uint64_t( header.numSlots ) * sizeof( uint32_t )
+		+ header.dataSize;
+}
+
+// Where each part of the archive starts
+struct ArchiveSections
+{
+	explicit ArchiveSections( const uint8_t* base )
+		: header( reinterpret_cast<const ArchiveHeader*>( base ) )
+	{
+		const uint8_t* at = base + sizeof( ArchiveHeader );
+		records = reinterpret_cast<const ArchiveRecord*>( at );
+		at += header->numDictionaries * sizeof( ArchiveRecord );
+		pairs = reinterpret_cast<const Pair*>( at );
+		at += header->numPairs * sizeof( Pair );
+		strings = reinterpret_cast<const ArchiveString*>( at );
+		at += header->numStrings * sizeof( ArchiveString );
+		slots = reinterpret_cast<const uint32_t*>( at );
+		at += header->numSlots * sizeof( uint32_t );
+		data = reinterpret_cast<const char*>( at );
+	}
+
+	const ArchiveHeader*	header;
+	const ArchiveRecord*	records;
+	const Pair*		pairs;
+	const ArchiveString* strings;
+	const uint32_t*	slots;
+	const char*		data;
+};
+
+bool DictionaryView::KeyExists( StringView keyname ) const
+{
+	return nullptr != FindPair( keyname );
+}
+
+size_t DictionaryView::GetNumKeys() const
+{
+	return numPairs;
+}
+
+StringView DictionaryView::GetKey( size_t index ) const
+{
+	return index < numPairs ? DictionaryArchive::GetString( base, pairs[index].key ) : StringView();
+}
+
+StringView DictionaryView::GetString( StringView keyname, StringView defaultValue ) const
+{
+	const Pair* pair = FindPair( keyname );
+	return nullptr != pair ? DictionaryArchive::GetString( base, pair->text ) : defaultValue;
+}
+
+const char* DictionaryView::GetCString( StringView keyname, const char* defaultValue ) const
+{
+	const Pair* pair = FindPair( keyname );
+	return nullptr != pair ? DictionaryArchive::GetString( base, pair->text ).data() : defaultValue;
+}
+
+float DictionaryView::GetFloat( StringView keyname, float defaultValue ) const
+{
+	const Pair* pair = FindPair( keyname );
+	return nullptr != pair ? pair->number : defaultValue;
+}
+
+int DictionaryView::GetInteger( StringView keyname, int defaultValue ) const
+{
+	const Pair* pair = FindPair( keyname );
+	return nullptr != pair ? pair->integer : defaultValue;
+}
+
+bool DictionaryView::GetBool( StringView keyname, bool defaultValue ) const
+{
+	const Pair* pair = FindPair( keyname );
+	return nullptr != pair ? pair->boolean != 0U : defaultValue;
+}
+
+Vec3 DictionaryView::GetVec3( StringView keyname, const Vec3& defaultValue ) const
+{
+	const Pair* pair = FindPair( keyname );
+	return nullptr != pair ? Vec3( pair->vector ) : defaultValue;
+}
+
+Dictionary DictionaryView::ToDictionary() const
+{
+	Dictionary dict;
+	for ( uint32_t i = 0U; i < numPairs; i++ )
+	{
+		const Pair& pair = pairs[i];
+		const StringView keyname = DictionaryArchive::GetString( base, pair.key );
+
+		switch ( pair.type )
+		{
+		case DictionaryTypes::Float: dict.SetFloat( keyname, pair.number ); break;
+		case DictionaryTypes::Integer: dict.SetInteger( keyname, pair.integer ); break;
+		case DictionaryTypes::Boolean: dict.SetBool( keyname, pair.boolean != 0U ); break;
+		case DictionaryTypes::Vec3: dict.SetVec3( keyname, Vec3( pair.vector ) ); break;
+		default: dict.SetString( keyname, DictionaryArchive::GetString( base, pair.text ) ); break;
+		}
+	}
+
+	return dict;
+}
+
+// Keys are compared by ID, so the key's text is only looked at once
+const Pair* DictionaryView::FindPair( StringView keyname ) const
+{
+	if ( 0U == numPairs )
+	{
+		return nullptr;
+	}
+
+	const SymbolId key = DictionaryArchive::FindString( base, keyname );
+	if ( key == InvalidSymbol )
+	{
+		return nullptr;
+	}
+
+	for ( uint32_t i = 0U; i < numPairs; i++ )
+	{
+		if ( pairs[i].key == key )
+		{
+			return &pairs[i];
+		}
+	}
+
+	return nullptr;
+}
+
+Vector<uint8_t> DictionaryArchive::Serialise( const Vector<Dictionary>& dictionaries )
+{
+	SymbolTable strings;
+	Vector<ArchiveRecord> records;
+	Vector<Pair> pairs;
+	records.reserve( dictionaries.size() );
+
+	for ( const Dictionary& dict : dictionaries )
+	{
+		records.push_back( { uint32_t( pairs.size() ), uint32_t( dict.GetNumKeys() ) } );
+		for ( const auto& [keyname, value] : dict )
+		{
+			const Vec3 vector = value.GetVec3();
+
+			Pair& pair = pairs.emplace_back();
+			pair.key = strings.Intern( keyname );
+			pair.text = strings.Intern( value.GetString() );
+			pair.number = value.GetFloat();
+			pair.integer = value.GetInteger();
+			pair.vector[0] = vector.x;
+			pair.vector[1] = vector.y;
+			pair.vector[2] = vector.z;
+			pair.type = value.GetType();
+			pair.boolean = value.GetBool() ? 1U : 0U;
+		}
+	}
+
+	// At most half full, so misses are found quickly
+	uint32_t numSlots = MinimumArchiveSlots;
+	while ( numSlots < strings.GetCount() * 2U )
+	{
+		numSlots *= 2U;
+	}
+
+	Vector<ArchiveString> entries( strings.GetCount() );
+	Vector<uint32_t> slots( numSlots, 0U );
+	uint32_t dataSize = 0U;
+	for ( SymbolId id = 0U; id < strings.GetCount(); id++ )
+	{
+		entries[id] = { dataSize, uint32_t( strings.GetName( id ).size() ) };
+		dataSize += entries[id].length + 1U;
+
+		uint32_t slot = strings.GetHash( id ) & (numSlots - 1U);
+		while ( slots[slot] != 0U )
+		{
+			slot = (slot + 1U) & (numSlots - 1U);
+		}
+		slots[slot] = id + 1U;
+	}
+
+	ArchiveHeader header{};
+	std::memcpy( header.magic, ArchiveMagic, sizeof( ArchiveMagic ) );
+	header.version = Version;
+	header.numDictionaries = uint32_t( records.size() );
+	header.numPairs = uint32_t( pairs.size() );
+	header.numStrings = uint32_t( entries.size() );
+	header.numSlots = numSlots;
+	header.dataSize = dataSize;
+
+	Vector<uint8_t> bytes;
+	const auto append = [&bytes]( const void* data, size_t size )
+	{
+		const uint8_t* begin = static_cast<const uint8_t*>( data );
+		bytes.insert( bytes.end(), begin, begin + size );
+	};
+
+	bytes.reserve( sizeof( ArchiveHeader ) + records.size() * sizeof( ArchiveRecord ) + pairs.size() * sizeof( Pair )
+		+ entries.size() * sizeof( ArchiveString ) + slots.size() * sizeof( uint32_t ) + dataSize );
+
+	append( &header, sizeof( header ) );
+	append( records.data(), records.size() * sizeof( ArchiveRecord ) );
+	append( pairs.data(), pairs.size() * sizeof( Pair ) );
+	append( entries.data(), entries.size() * sizeof( ArchiveString ) );
+	append( slots.data(), slots.size() * sizeof( uint32_t ) );
+	for ( SymbolId id = 0U; id < strings.GetCount(); id++ )
+	{
+		const StringView name = strings.GetName( id );
+		append( name.data(), name.size() );
+		bytes.push_back( 0U );
+	}
+
+	const uint32_t checksum = ArchiveChecksum( bytes.data(), bytes.size() );
+	std::memcpy( bytes.data() + offsetof( ArchiveHeader, checksum ), &checksum, sizeof( checksum ) );
+	const uint32_t headerChecksum = HeaderChecksum( bytes.data() );
+	std::memcpy( bytes.data() + offsetof( ArchiveHeader, headerChecksum ), &headerChecksum, sizeof( headerChecksum ) );
+
+	return bytes;
+}
+
+bool DictionaryArchive::Write( StringView filePath, const Vector<Dictionary>& dictionaries )
+{
+	const Vector<uint8_t> bytes = Serialise( dictionaries );
+
+	std::ofstream file( String( filePath ), std::ios::binary | std::ios::trunc );
+	if ( !file )
+	{
+		return false;
+	}
+
+	file.write( reinterpret_cast<const char*>( bytes.data() ), std::streamsize( bytes.size() ) );
+	return bool( file );
+}
+
+Optional<DictionaryArchive> DictionaryArchive::FromFile( StringView filePath )
+{
+	auto file = std::make_shared<MappedFile>( filePath );
+	if ( !*file )
+	{
+		return {};
+	}
+
+	auto archive = FromMemory( file->GetData(), file->GetSize() );
+	if ( archive )
+	{
+		archive->mappedFile = std::move( file );
+	}
+
+	return archive;
+}
+
+Optional<DictionaryArchive> DictionaryArchive::FromMemory( const void* data, size_t size )
+{
+	const uint8_t* bytes = static_cast<const uint8_t*>( data );
+	if ( reinterpret_cast<uintptr_t>( bytes ) % alignof( uint32_t ) != 0U || !IsHeaderValid( bytes, size ) )
+	{
+		return {};
+	}
+
+	DictionaryArchive archive;
+	archive.base = bytes;
+	archive.size = size;
+	return archive;
+}
+
+bool DictionaryArchive::Verify() const
+{
+	return nullptr != base && IsValid( base, size );
+}
+
+size_t DictionaryArchive::GetCount() const
+{
+	return nullptr != base ? reinterpret_cast<const ArchiveHeader*>( base )->numDictionaries : 0U;
+}
+
+DictionaryView DictionaryArchive::Get( size_t index ) const
+{
+	DictionaryView view;
+	if ( index >= GetCount() )
+	{
+		return view;
+	}
+
+	const ArchiveSections sections( base );
+	const ArchiveRecord& record = sections.records[index];
+	if ( uint64_t( record.firstPair ) + record.numPairs > sections.header->numPairs )
+	{
+		return view;
+	}
+
+	view.base = base;
+	view.pairs = sections.pairs + record.firstPair;
+	view.numPairs = record.numPairs;
+
+	return view;
+}
+
+// Only the header is looked at, so every section is known
+// to be inside the archive, what's in them isn't checked
+bool DictionaryArchive::IsHeaderValid( const uint8_t* data, size_t size )
+{
+	if ( size < sizeof( ArchiveHeader ) )
+	{
+		return false;
+	}
+
+	const ArchiveHeader& header = *reinterpret_cast<const ArchiveHeader*>( data );
+	if ( std::memcmp( header.magic, ArchiveMagic, sizeof( ArchiveMagic ) ) != 0 || header.version != Version
+		|| HeaderChecksum( data ) != header.headerChecksum )
+	{
+		return false;
+	}
+
+	if ( header.numSlots < MinimumArchiveSlots || (header.numSlots & (header.numSlots - 1U)) != 0U
+		|| header.numSlots <= header.numStrings )
+	{
+		return false;
+	}
+
+	return ArchiveSize( header ) <= size;
+}
+
+// Goes through the whole archive, checksum included
+bool DictionaryArchive::IsValid( const uint8_t* data, size_t size )
+{
+	if ( !IsHeaderValid( data, size ) )
+	{
+		return false;
+	}
+
+	const ArchiveHeader& header = *reinterpret_cast<const ArchiveHeader*>( data );
+	if ( ArchiveChecksum( data, size_t( ArchiveSize( header ) ) ) != header.checksum )
+	{
+		return false;
+	}
+
+	const ArchiveSections sections( data );
+	for ( uint32_t i = 0U; i < header.numDictionaries; i++ )
+	{
+		const ArchiveRecord& record = sections.records[i];
+		if ( uint64_t( record.firstPair ) + record.numPairs > header.numPairs )
+		{
+			return false;
+		}
+	}
+
+	for ( uint32_t i = 0U; i < header.numPairs; i++ )
+	{
+		if ( sections.pairs[i].key >= header.numStrings || sections.pairs[i].text >= header.numStrings )
+		{
+			return false;
+		}
+	}
+
+	for ( uint32_t i = 0U; i < header.numStrings; i++ )
+	{
+		const ArchiveString& entry = sections.strings[i];
+		if ( uint64_t( entry.offset ) + entry.length >= header.dataSize || sections.data[entry.offset + entry.length] != '\0' )
+		{
+			return false;
+		}
+	}
+
+	// Lookups stop at an empty slot, so there has to be one
+	uint32_t usedSlots = 0U;
+	for ( uint32_t i = 0U; i < header.numSlots; i++ )
+	{
+		if ( sections.slots[i] > header.numStrings )
+		{
+			return false;
+		}
+
+		usedSlots += sections.slots[i] != 0U ? 1U : 0U;
+	}
+
+	return usedSlots < header.numSlots;
+}
+
+// Only the header was checked on load, so the IDs and strings
+// are checked as they're read, a broken archive gives misses
+SymbolId DictionaryArchive::FindString( const uint8_t* base, StringView text )
+{
+	const ArchiveSections sections( base );
+	const uint32_t mask = sections.header->numSlots - 1U;
+	uint32_t slot = SymbolTable::Hash( text ) & mask;
+
+	// Valid archives always have an empty slot, broken ones may not
+	for ( uint32_t probe = 0U; probe < sections.header->numSlots && sections.slots[slot] != 0U; probe++ )
+	{
+		const SymbolId id = sections.slots[slot] - 1U;
+		if ( GetString( base, id ) == text )
+		{
+			return id;
+		}
+
+		slot = (slot + 1U) & mask;
+	}
+
+	return InvalidSymbol;
+}
+
+// @returns The string, or an empty one if the ID or the string is out of bounds
+StringView DictionaryArchive::GetString( const uint8_t* base, SymbolId id )
+{
+	const ArchiveSections sections( base );
+	if ( id >= sections.header->numStrings )
+	{
+		return StringView( "", 0U );
+	}
+
+	const ArchiveString& entry = sections.strings[id];
+	if ( uint64_t( entry.offset ) + entry.length >= sections.header->dataSize || sections.data[entry.offset + entry.length] != '\0' )
+	{
+		return StringView( "", 0U );
+	}
+
+	return StringView( sections.data + entry.offset, entry.length );
+}
@@ -0,0 +1,124 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+namespace adm
+{
+	class MappedFile;
+
+	// ============================
+	// DictionaryView
+	//
+	// One dictionary in a DictionaryArchive, read straight
+	// from the archive's bytes, nothing is converted or copied
+	// It's valid for as long as the archive's bytes are
+	// ============================
+	class DictionaryView final
+	{
+	public:
+		// How a pair is stored, see DictionaryArchive.cpp
+		struct Pair;
+
+		DictionaryView() = default;
+
+		bool		KeyExists( StringView keyname ) const;
+		size_t		GetNumKeys() const;
+		StringView	GetKey( size_t index ) const;
+
+		// Values that weren't text were formatted like
+		// Dictionary does it, when the archive was written
+		StringView	GetString( StringView keyname, StringView defaultValue = {} ) const;
+		const char* GetCString( StringView keyname, const char* defaultValue = "" ) const;
+		float		GetFloat( StringView keyname, float defaultValue = 0.0f ) const;
+		int			GetInteger( StringView keyname, int defaultValue = 0 ) const;
+		bool		GetBool( StringView keyname, bool defaultValue = false ) const;
+		Vec3		GetVec3( StringView keyname, const Vec3& defaultValue = Vec3::Zero ) const;
+
+		// Makes a regular dictionary out of it, with the same value types
+		Dictionary	ToDictionary() const;
+
+	private:
+		friend class DictionaryArchive;
+
+		const Pair*	FindPair( StringView keyname ) const;
+
+		// The start of the archive
+		const uint8_t* base{ nullptr };
+		const Pair*	pairs{ nullptr };
+		uint32_t	numPairs{ 0 };
+	};
+
+	// ============================
+	// DictionaryArchive
+	//
+	// A binary format for arrays of dictionaries, meant to be
+	// memory-mapped and read in place, e.g. a level's entities
+	// Usage:
+	//
+	// DictionaryArchive::Write( "maps/test.ents", entities );
+	// ...
+	// auto archive = DictionaryArchive::FromFile( "maps/test.ents" );
+	// Vec3 origin = archive->Get( 0 ).GetVec3( "origin" );
+	//
+	// Keys and values go into one table of unique strings, with
+	// a hash table over it, and every value is stored along with
+	// what it converts to as a float, integer, bool and Vec3
+	// The byte order is the writer's, so archives aren't meant
+	// to be moved between big and little-endian machines
+	//
+	// Loading only checks the header, which has a checksum of
+	// its own, so it takes the same time for any size of archive
+	// and doesn't touch the pages that are never read
+	// Truncated files are turned away, since the header says
+	// how big the archive is, but corrupted contents aren't:
+	// reads stay in bounds, and give misses and empty strings
+	// where the archive is broken
+	// Verify goes through all of it, checksum included, which
+	// reads the whole file, so call it where that's worth it,
+	// e.g. on files that came from somewhere else
+	// ============================
+	class DictionaryArchive final
+	{
+	public:
+		static constexpr uint32_t Version = 3U;
+
+		// @returns The dictionaries in the archive format
+		static Vector<uint8_t> Serialise( const Vector<Dictionary>& dictionaries );
+		// @returns False if the file could not be written
+		static bool		Write( StringView filePath, const Vector<Dictionary>& dictionaries );
+
+		// Memory-maps the archive, nothing is copied out of it
+		// @returns Nothing if the file can't be opened or its header isn't valid
+		static Optional<DictionaryArchive> FromFile( StringView filePath );
+		// Reads the archive in place, the bytes must be 4-byte aligned and outlive it
+		// @returns Nothing if the header isn't valid
+		static Optional<DictionaryArchive> FromMemory( const void* data, size_t size );
+
+		// @returns How many dictionaries there are
+		size_t			GetCount() const;
+		// @returns The dictionary, or an empty view if the index is out of range
+		DictionaryView	Get( size_t index ) const;
+		// Checks the whole archive and its checksum, reading every byte of it
+		// @returns False if anything in it is corrupted
+		bool			Verify() const;
+
+		DictionaryView	operator[]( size_t index ) const
+		{
+			return Get( index );
+		}
+
+	private:
+		friend class DictionaryView;
+
+		static bool		IsHeaderValid( const uint8_t* data, size_t size );
+		static bool		IsValid( const uint8_t* data, size_t size );
+		// @returns The ID of the string in the archive, or InvalidSymbol
+		static SymbolId	FindString( const uint8_t* base, StringView text );
+		static StringView GetString( const uint8_t* base, SymbolId id );
+
+		const uint8_t*	base{ nullptr };
+		size_t			size{ 0 };
+		SharedPtr<MappedFile> mappedFile;
+	};
+}
@@ -0,0 +1,601 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+namespace adm
+{
+	// Hashes used by FlatMap, same as std::hash, except
+	// String keys can be looked up by views without copying
+	template<class TKey>
+	struct FlatMapHash : std::hash<TKey>
+	{
+	};
+
+	template<>
+	struct FlatMapHash<String>
+	{
+		size_t operator()( StringView key ) const
+		{
+			return std::hash<StringView>()( key );
+		}
+	};
+
+	// ============================
+	// FlatMap
+	//
+	// Open-addressing hash map, with one control byte per slot
+	// like SwissTable, so a probe checks 16 slots at a time
+	// Keys and values are stored right in the slot array, so
+	// there's no allocation per entry, and strings short enough
+	// for the small-string buffer (15 chars on most standard
+	// libraries) don't allocate anything either
+	//
+	// It mostly follows std::unordered_map, with two differences:
+	// - inserting can move the entries, so pointers, references
+	//   and iterators are invalidated by it, erasing keeps them
+	// - String keys are looked up with StringView, so looking
+	//   up a const char* doesn't make a temporary std::string
+	//
+	// Building with ADMUTIL_USE_FLAT_MAP makes adm::Map use this
+	// ============================
+	template<class TKey, class TValue>
+	class FlatMap final
+	{
+	public:
+		using key_type = TKey;
+		using mapped_type = TValue;
+		using value_type = std::pair<const TKey, TValue>;
+		using size_type = size_t;
+		using hasher = FlatMapHash<TKey>;
+		// What find() and friends take, views for string keys
+		using LookupKey = std::conditional_t<std::is_same_v<TKey, String>, StringView, const TKey&>;
+
+		template<bool Const>
+		class Iterator final
+		{
+		public:
+			using iterator_category = std::forward_iterator_tag;
+			using value_type = typename FlatMap::value_type;
+			using difference_type = ptrdiff_t;
+			using pointer = std::conditional_t<Const, const value_type*, value_type*>;
+			using reference = std::conditional_t<Const, const value_type&, value_type&>;
+
+			Iterator() = default;
+			Iterator( const int8_t* controls, pointer slots, size_t index, size_t capacity )
+				: controls( controls ), slots( slots ), index( index ), capacity( capacity )
+			{
+				SkipEmpty();
+			}
+
+			// Non-const iterators turn into const ones
+			template<bool IsConst = Const, typename = std::enable_if_t<!IsConst>>
+			operator Iterator<true>() const
+			{
+				return Iterator<true>( controls, slots, index, capacity );
+			}
+
+			reference operator*() const
+			{
+				return slots[index];
+			}
+
+			pointer operator->() const
+			{
+				return slots + index;
+			}
+
+			Iterator& operator++()
+			{
+				index++;
+				SkipEmpty();
+				return *this;
+			}
+
+			Iterator operator++( int )
+			{
+				Iterator old = *this;
+				++(*this);
+				return old;
+			}
+
+			bool operator==( const Iterator& other ) const
+			{
+				return index == other.index && slots == other.slots;
+			}
+
+			bool operator!=( const Iterator& other ) const
+			{
+				return !(*this == other);
+			}
+
+		private:
+			friend class FlatMap;
+
+			void SkipEmpty()
+			{
+				while ( index < capacity && controls[index] < 0 )
+				{
+					index++;
+				}
+			}
+
+			const int8_t* controls{ nullptr };
+			pointer slots{ nullptr };
+			size_t index{ 0 };
+			size_t capacity{ 0 };
+		};
+
+		using iterator = Iterator<false>;
+		using const_iterator = Iterator<true>;
+
+		FlatMap() = default;
+
+		FlatMap( std::initializer_list<value_type> list )
+		{
+			reserve( list.size() );
+			for ( const value_type& pair : list )
+			{
+				insert( pair );
+			}
+		}
+
+		FlatMap( const FlatMap& map )
+		{
+			reserve( map.size() );
+			for ( const value_type& pair : map )
+			{
+				Insert( Hash( pair.first ), pair.first, pair.second );
+			}
+		}
+
+		FlatMap( FlatMap&& map ) noexcept
+		{
+			Swap( map );
+		}
+
+		~FlatMap()
+		{
+			Free();
+		}
+
+		FlatMap& operator=( const FlatMap& map )
+		{
+			if ( this != &map )
+			{
+				FlatMap copy( map );
+				Swap( copy );
+			}
+
+			return *this;
+		}
+
+		FlatMap& operator=( FlatMap&& map ) noexcept
+		{
+			if ( this != &map )
+			{
+				Free();
+				Swap( map );
+			}
+
+			return *this;
+		}
+
+		iterator begin()
+		{
+			return iterator( controls.get(), slots, 0U, capacity );
+		}
+
+		const_iterator begin() const
+		{
+			return const_iterator( controls.get(), slots, 0U, capacity );
+		}
+
+		iterator end()
+		{
+			return iterator( controls.get(), slots, capacity, capacity );
+		}
+
+		const_iterator end() const
+		{
+			return const_iterator( controls.get(), slots, capacity, capacity );
+		}
+
+		bool empty() const
+		{
+			return numEntries == 0U;
+		}
+
+		size_t size() const
+		{
+			return numEntries;
+		}
+
+		// Destroys all entries, but keeps the memory around
+		void clear()
+		{
+			for ( size_t i = 0U; i < capacity; i++ )
+			{
+				if ( controls[i] >= 0 )
+				{
+					std::destroy_at( slots + i );
+				}
+			}
+
+			ResetControls();
+			numEntries = 0U;
+		}
+
+		// Makes room for this many entries, so inserting them won't move anything
+		void reserve( size_t entries )
+		{
+			const size_t needed = CapacityFor( entries );
+			if ( needed > capacity )
+			{
+				Rehash( needed );
+			}
+		}
+
+		iterator find( LookupKey key )
+		{
+			return iterator( controls.get(), slots, Find( Hash( key ), key ), capacity );
+		}
+
+		const_iterator find( LookupKey key ) const
+		{
+			return const_iterator( controls.get(), slots, Find( Hash( key ), key ), capacity );
+		}
+
+		size_t count( LookupKey key ) const
+		{
+			return Find( Hash( key ), key ) != capacity ? 1U : 0U;
+		}
+
+		bool contains( LookupKey key ) const
+		{
+			return Find( Hash( key ), key ) != capacity;
+		}
+
+		TValue& at( LookupKey key )
+		{
+			const size_t index = Find( Hash( key ), key );
+			if ( index == capacity )
+			{
+				throw std::out_of_range( "adm::FlatMap::at: no such key" );
+			}
+
+			return slots[index].second;
+		}
+
+		const TValue& at( LookupKey key ) const
+		{
+			return const_cast<FlatMap*>( this )->at( key );
+		}
+
+		TValue& operator[]( LookupKey key )
+		{
+			return try_emplace( key ).first->second;
+		}
+
+		template<typename... Args>
+		std::pair<iterator, bool> try_emplace( LookupKey key, Args&&... args )
+		{
+			const size_t hash = Hash( key );
+			const size_t index = Find( hash, key );
+			if ( index != capacity )
+			{
+				return { iterator( controls.get(), slots, index, capacity ), false };
+			}
+
+			return { Insert( hash, key, std::forward<Args>( args )... ), true };
+		}
+
+		// Moves the key in, for keys that are expensive to copy or can't be
+		template<typename TMovedKey, typename... Args, typename = std::enable_if_t<std::is_same_v<TMovedKey, TKey>>>
+		std::pair<iterator, bool> try_emplace( TMovedKey&& key, Args&&... args )
+		{
+			const size_t hash = Hash( key );
+			const size_t index = Find( hash, key );
+			if ( index != capacity )
+			{
+				return { iterator( controls.get(), slots, index, capacity ), false };
+			}
+
+			return { Insert( hash, std::move( key ), std::forward<Args>( args )... ), true };
+		}
+
+		template<typename... Args>
+		std::pair<iterator, bool> emplace( Args&&... args )
+		{
+			std::pair<TKey, TValue> pair( std::forward<Args>( args )... );
+			return try_emplace( std::move( pair.first ), std::move( pair.second ) );
+		}
+
+		std::pair<iterator, bool> insert( const value_type& pair )
+		{
+			return try_emplace( pair.first, pair.second );
+		}
+
+		std::pair<iterator, bool> insert( value_type&& pair )
+		{
+			return try_emplace( pair.first, std::move( pair.second ) );
+		}
+
+		template<typename TMapped>
+		std::pair<iterator, bool> insert_or_assign( LookupKey key, TMapped&& value )
+		{
+			auto result = try_emplace( key, std::forward<TMapped>( value ) );
+			if ( !result.second )
+			{
+				result.first->second = std::forward<TMapped>( value );
+			}
+
+			return result;
+		}
+
+		size_t erase( LookupKey key )
+		{
+			const size_t index = Find( Hash( key ), key );
+			if ( index == capacity )
+			{
+				return 0U;
+			}
+
+			Erase( index );
+			return 1U;
+		}
+
+		iterator erase( const_iterator position )
+		{
+			Erase( position.index );
+			return iterator( controls.get(), slots, position.index + 1U, capacity );
+		}
+
+	private:
+		static constexpr size_t GroupSize = 16U;
+		// Control bytes, full slots store the top 7 bits of their hash instead
+		static constexpr int8_t Empty = -128;
+		static constexpr int8_t Deleted = -2;
+
+		// Spreads the bits out, std::hash is the identity for integers
+		// The group comes from the low bits and the control byte from
+		// the top 7, so every bit of the key has to reach both ends
+		// A multiply alone only carries bits upwards, and keys with
+		// their low bits clear (shifted IDs, aligned pointers) would
+		// all start probing from the same group, hence MurmurHash3's
+		// finaliser
+		static uint64_t Mix( size_t hash )
+		{
+			uint64_t result = uint64_t( hash );
+			result ^= result >> 33U;
+			result *= 0xFF51AFD7ED558CCDULL;
+			result ^= result >> 33U;
+			result *= 0xC4CEB9FE1A85EC53ULL;
+			result ^= result >> 33U;
+			return result;
+		}
+
+		static size_t Hash( LookupKey key )
+		{
+			return size_t( Mix( hasher()( key ) ) );
+		}
+
+		static int8_t ControlFor( size_t hash )
+		{
+			return int8_t( uint64_t( hash ) >> 57U );
+		}
+
+		// Bit i is set if control byte i of the group matches
+		static uint32_t Match( const int8_t* group, int8_t control )
+		{
+#if ADM_USE_SSE41
+			const __m128i bytes = _mm_loadu_si128( reinterpret_cast<const __m128i*>( group ) );
+			return uint32_t( _mm_movemask_epi8( _mm_cmpeq_epi8( bytes, _mm_set1_epi8( control ) ) ) );
+#else
+			uint32_t mask = 0U;
+			for ( size_t i = 0U; i < GroupSize; i++ )
+			{
+				mask |= uint32_t( group[i] == control ) << i;
+			}
+			return mask;
+#endif
+		}
+
+		// Bit i is set if slot i of the group is empty or deleted
+		static uint32_t MatchFree( const int8_t* group )
+		{
+#if ADM_USE_SSE41
+			const __m128i bytes = _mm_loadu_si128( reinterpret_cast<const __m128i*>( group ) );
+			return uint32_t( _mm_movemask_epi8( bytes ) );
+#else
+			uint32_t mask = 0U;
+			for ( size_t i = 0U; i < GroupSize; i++ )
+			{
+				mask |= uint32_t( group[i] < 0 ) << i;
+			}
+			return mask;
+#endif
+		}
+
+		static uint32_t LowestBit( uint32_t mask )
+		{
+#if defined( _MSC_VER )
+			unsigned long bit = 0;
+			_BitScanForward( &bit, mask );
+			return uint32_t( bit );
+#else
+			return uint32_t( __builtin_ctz( mask ) );
+#endif
+		}
+
+		// Smallest power of two, with at least one group,
+		// that keeps the table at most 7/8 full
+		static size_t CapacityFor( size_t entries )
+		{
+			size_t result = GroupSize;
+			while ( result - result / 8U < entries )
+			{
+				result *= 2U;
+			}
+
+			return result;
+		}
+
+		// Groups are probed in triangular steps, which
+		// visits every group when there are 2^n of them
+		// @returns The index of the key's slot, or capacity if it's not there
+		size_t Find( size_t hash, LookupKey key ) const
+		{
+			if ( numEntries == 0U )
+			{
+				return capacity;
+			}
+
+			const int8_t control = ControlFor( hash );
+			const size_t groupMask = capacity / GroupSize - 1U;
+			size_t group = hash & groupMask;
+
+			for ( size_t step = 1U; ; step++ )
+			{
+				const int8_t* groupControls = controls.get() + group * GroupSize;
+				for ( uint32_t mask = Match( groupControls, control ); mask != 0U; mask &= mask - 1U )
+				{
+					const size_t index = group * GroupSize + LowestBit( mask );
+					if ( slots[index].first == key )
+					{
+						return index;
+					}
+				}
+
+				// An empty slot means the probe never got past this group
+				if ( Match( groupControls, Empty ) != 0U )
+				{
+					return capacity;
+				}
+
+				group = (group + step) & groupMask;
+			}
+		}
+
+		// @returns The first empty or deleted slot along the key's probe
+		size_t FindFree( size_t hash ) const
+		{
+			const size_t groupMask = capacity / GroupSize - 1U;
+			size_t group = hash & groupMask;
+
+			for ( size_t step = 1U; ; step++ )
+			{
+				const uint32_t mask = MatchFree( controls.get() + group * GroupSize );
+				if ( mask != 0U )
+				{
+					return group * GroupSize + LowestBit( mask );
+				}
+
+				group = (group + step) & groupMask;
+			}
+		}
+
+		// The key must not be in the map already
+		template<typename TKeyArg, typename... Args>
+		iterator Insert( size_t hash, TKeyArg&& key, Args&&... args )
+		{
+			if ( growthLeft == 0U )
+			{
+				// Rehashing at the same capacity is enough to clear out deleted slots
+				Rehash( CapacityFor( std::max<size_t>( numEntries * 2U, numEntries + 1U ) ) );
+			}
+
+			const size_t index = FindFree( hash );
+			if ( controls[index] == Empty )
+			{
+				growthLeft--;
+			}
+
+			new ( slots + index ) value_type( std::piecewise_construct,
+				std::forward_as_tuple( std::forward<TKeyArg>( key ) ), std::forward_as_tuple( std::forward<Args>( args )... ) );
+			controls[index] = ControlFor( hash );
+			numEntries++;
+
+			return iterator( controls.get(), slots, index, capacity );
+		}
+
+		// Deleted slots keep counting towards the load, until the next rehash
+		void Erase( size_t index )
+		{
+			std::destroy_at( slots + index );
+			controls[index] = Deleted;
+			numEntries--;
+		}
+
+		void Rehash( size_t newCapacity )
+		{
+			UniquePtr<int8_t[]> oldControls = std::move( controls );
+			value_type* oldSlots = slots;
+			const size_t oldCapacity = capacity;
+
+			capacity = newCapacity;
+			controls = std::make_unique<int8_t[]>( capacity );
+			slots = std::allocator<value_type>().allocate( capacity );
+			ResetControls();
+			growthLeft -= numEntries;
+
+			for ( size_t i = 0U; i < oldCapacity; i++ )
+			{
+				if ( oldControls[i] < 0 )
+				{
+					continue;
+				}
+
+				const size_t hash = Hash( oldSlots[i].first );
+				const size_t index = FindFree( hash );
+				// The old entry is destroyed right after, so its key can be
+				// moved from, move-only ones too, despite being const
+				new ( slots + index ) value_type( std::move( const_cast<TKey&>( oldSlots[i].first ) ), std::move( oldSlots[i].second ) );
+				controls[index] = ControlFor( hash );
+				std::destroy_at( oldSlots + i );
+			}
+
+			if ( nullptr != oldSlots )
+			{
+				std::allocator<value_type>().deallocate( oldSlots, oldCapacity );
+			}
+		}
+
+		void ResetControls()
+		{
+			std::fill_n( controls.get(), capacity, Empty );
+			growthLeft = capacity - capacity / 8U;
+		}
+
+		void Free()
+		{
+			if ( nullptr == slots )
+			{
+				return;
+			}
+
+			clear();
+			std::allocator<value_type>().deallocate( slots, capacity );
+			slots = nullptr;
+			controls.reset();
+			capacity = 0U;
+			growthLeft = 0U;
+		}
+
+		void Swap( FlatMap& map )
+		{
+			std::swap( controls, map.controls );
+			std::swap( slots, map.slots );
+			std::swap( capacity, map.capacity );
+			std::swap( numEntries, map.numEntries );
+			std::swap( growthLeft, map.growthLeft );
+		}
+
+		UniquePtr<int8_t[]> controls;
+		value_type*		slots{ nullptr };
+		size_t			capacity{ 0 };
+		size_t			numEntries{ 0 };
+		// How many more entries fit before a rehash, deleted slots count as taken
+		size_t			growthLeft{ 0 };
+	};
+}
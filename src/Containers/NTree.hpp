@@ -4,8 +4,6 @@
 #pragma once
 
 // TODO:
-// - use indices instead of pointers to elements in NTreeNode (better for searching)
-// - use a vector of indices instead of a linked list of pointers (better for searching)
 // - NTree::NodeType looks redundant and could be a template parameter instead
 // - write a Rect class so we can have quadtrees
 // - add relinking functionality, which will only 
@@ -14,325 +12,1291 @@
 
 namespace adm
 {
-	// Non-copyable NTree node
+	template<typename elementType, typename boundingVolumeType, size_t Dimensions, typename Policy>
+	class NTree;
+
+	// NTree node, kept by value in its tree's array of nodes
+	// It refers to its children and elements by index, so it
+	// only means something together with the tree it's from
 	template<typename elementType, typename boundingVolumeType, size_t Dimensions>
 	struct NTreeNode
 	{
-		using ForEachChildFn = void( NTreeNode* );
-		using ForEachElementFn = void( elementType );
-		using GetSubdividedVolumeForChildFn = boundingVolumeType( boundingVolumeType, size_t );
-
 		static constexpr size_t Combinations = 1 << Dimensions;
+		// What GetFirstChild returns for nodes without children
+		static constexpr uint32_t NoChildren = ~uint32_t( 0 );
 
 		NTreeNode() = default;
-		NTreeNode( const NTreeNode& node ) = delete;
-		NTreeNode( NTreeNode&& node ) = default;
-		NTreeNode& operator=( NTreeNode&& node ) = default;
 
 		NTreeNode( const boundingVolumeType& boundingVolume )
-			: boundingVolume( boundingVolume ), numElements( 0 )
+			: boundingVolume( boundingVolume )
+		{
+		}
+
+		// Has no children, but has elements
+		bool IsLeaf() const
+		{
+			return !HasChildren() && numElements > 0U;
+		}
+
+		bool IsEmpty() const
+		{
+			return numElements == 0U;
+		}
+
+		bool HasChildren() const
+		{
+			return firstChild != NoChildren;
+		}
+
+		const boundingVolumeType& GetBoundingVolume() const
+		{
+			return boundingVolume;
+		}
+
+		// The elements of the whole subtree, a node with children
+		// covers the same range as all of its children together
+		int32_t GetNumElements() const
+		{
+			return int32_t( numElements );
+		}
+
+		// Index of the first element index in NTree::GetElementIndices
+		uint32_t GetFirstElement() const
+		{
+			return firstElement;
+		}
+
+		// Index of the first child in NTree::GetNodes, the rest come right after it
+		uint32_t GetFirstChild() const
+		{
+			return firstChild;
+		}
+
+	private:
+		template<typename, typename, size_t, typename>
+		friend class NTree;
+
+		boundingVolumeType boundingVolume{};
+		uint32_t firstChild{ NoChildren };
+		// [firstElement, firstElement + numElements) in the tree's element indices
+		uint32_t firstElement{ 0 };
+		uint32_t numElements{ 0 };
+	};
+
+	// Quadtree node
+	//template<typename elementType>
+	//using QuadtreeNode = NTreeNode<elementType, Rect, 2>;
+
+	// Octree node
+	template<typename elementType>
+	using OctreeNode = NTreeNode<elementType, AABB, 3>;
+
+	// ============================
+	// NTree policies
+	// 
+	// An NTree asks its policy how to build itself:
+	// bool IntersectsBox( const elementType&, const AABB& ) - does the element intersect a node?
+	// bool HasOccupancy() - is OccupiesBox worth calling?
+	// float OccupiesBox( const elementType&, const AABB& ) - if the element intersects several
+	//		children, it goes to the one where this is the highest, e.g. how much of it is inside
+	// bool ShouldSubdivide( const NodeType& ) - with these elements loaded, should the node subdivide?
+	// boundingVolumeType GetSubdividedVolumeForChild( const boundingVolumeType&, size_t ) -
+	//		the volume of the parent's Nth child
+	// 
+	// Any class with these can be a policy, they're called directly, so they can be inlined
+	// ============================
+
+	// Calls functions given at runtime, the most flexible policy, and the default one,
+	// but it's an indirect call for every element in every node that is built
+	template<typename elementType, typename boundingVolumeType, size_t Dimensions>
+	struct NTreeFunctionPolicy
+	{
+		using NodeType = NTreeNode<elementType*, boundingVolumeType, Dimensions>;
+
+		// Does the element intersect an AABB?
+		using IntersectsBoxFn = bool( const elementType& element, const AABB& boundingVolume );
+		// If this is a non-point, how much of it is inside this box?
+		// Returned value can be any
+		using BoxOccupancyFn = float( const elementType& element, const AABB& boundingVolume );
+		// With these elements loaded, should this node subdivide any further?
+		using ShouldSubdivideFn = bool( const NodeType& );
+		// Get a subdivided bounding volume for the Nth child node
+		using GetSubdividedVolumeForChildFn = boundingVolumeType( boundingVolumeType, size_t );
+
+		bool IntersectsBox( const elementType& element, const AABB& volume ) const
+		{
+			return intersectsBox( element, volume );
+		}
+
+		bool HasOccupancy() const
+		{
+			return bool( occupiesBox );
+		}
+
+		float OccupiesBox( const elementType& element, const AABB& volume ) const
+		{
+			return occupiesBox( element, volume );
+		}
+
+		bool ShouldSubdivide( const NodeType& node ) const
+		{
+			return shouldSubdivide( node );
+		}
+
+		boundingVolumeType GetSubdividedVolumeForChild( const boundingVolumeType& volume, size_t index ) const
+		{
+			return getSubdividedVolumeForChild( volume, index );
+		}
+
+		// Function that returns whether or not an element intersects the bounding volume of a node
+		std::function<IntersectsBoxFn> intersectsBox;
+		// Function that returns how much of the element is occupied by the bounding volume, can be empty
+		std::function<BoxOccupancyFn> occupiesBox;
+		// Function that does the subdivision heuristic
+		std::function<ShouldSubdivideFn> shouldSubdivide;
+		// Function that subdivides the bounding volume of the parent node for the Nth child node
+		std::function<GetSubdividedVolumeForChildFn> getSubdividedVolumeForChild;
+	};
+
+	// Calls functions known at compile time, occupiesBox can be nullptr to not have one
+	// Example: NTreeStaticPolicy<Vec3, AABB, 3, utils::IntersectsAABB, utils::SimpleThreshold<Vec3, 16>, utils::GetAABBForChild>
+	template<typename elementType, typename boundingVolumeType, size_t Dimensions,
+		auto intersectsBox, auto shouldSubdivide, auto getSubdividedVolumeForChild, auto occupiesBox = nullptr>
+	struct NTreeStaticPolicy
+	{
+		using NodeType = NTreeNode<elementType*, boundingVolumeType, Dimensions>;
+
+		bool IntersectsBox( const elementType& element, const AABB& volume ) const
+		{
+			return intersectsBox( element, volume );
+		}
+
+		constexpr bool HasOccupancy() const
+		{
+			return !std::is_null_pointer_v<decltype( occupiesBox )>;
+		}
+
+		float OccupiesBox( const elementType& element, const AABB& volume ) const
+		{
+			if constexpr ( std::is_null_pointer_v<decltype( occupiesBox )> )
+			{
+				return 0.0f;
+			}
+			else
+			{
+				return occupiesBox( element, volume );
+			}
+		}
+
+		bool ShouldSubdivide( const NodeType& node ) const
+		{
+			return shouldSubdivide( node );
+		}
+
+		boundingVolumeType GetSubdividedVolumeForChild( const boundingVolumeType& volume, size_t index ) const
+		{
+			return getSubdividedVolumeForChild( volume, index );
+		}
+	};
+
+	// Non-copyable N-dimensional tree designed to host static elements
+	// 
+	// Nodes live in one array, the root being the first, and each
+	// node's children are next to each other in it. Elements aren't
+	// moved around, instead there's one array of their indices, in
+	// which every leaf owns a contiguous range
+	// 
+	// How it's built is up to the policy, see NTreeFunctionPolicy
+	template<typename elementType, typename boundingVolumeType, size_t Dimensions,
+		typename Policy = NTreeFunctionPolicy<elementType, boundingVolumeType, Dimensions>>
+	class NTree
+	{
+	public:
+		using NodeType = NTreeNode<elementType*, boundingVolumeType, Dimensions>;
+		using PolicyType = Policy;
+		static constexpr size_t Combinations = 1 << Dimensions;
+
+		// Only for NTreeFunctionPolicy
+		using FunctionPolicy = NTreeFunctionPolicy<elementType, boundingVolumeType, Dimensions>;
+		using IntersectsBoxFn = typename FunctionPolicy::IntersectsBoxFn;
+		using BoxOccupancyFn = typename FunctionPolicy::BoxOccupancyFn;
+		using ShouldSubdivideFn = typename FunctionPolicy::ShouldSubdivideFn;
+		using GetSubdividedVolumeForChildFn = typename FunctionPolicy::GetSubdividedVolumeForChildFn;
+
+	public:
+		NTree() = default;
+		NTree( const NTree& octree ) = delete;
+		NTree( NTree&& octree ) = default;
+		NTree& operator=( NTree&& octree ) = default;
+
+		explicit NTree( const boundingVolumeType& volume, Policy treePolicy = Policy() )
+		{
+			Initialise( volume, std::move( treePolicy ) );
+		}
+
+		// Only for NTreeFunctionPolicy
+		NTree( const boundingVolumeType& volume, std::function<IntersectsBoxFn> intersectsBoxFunction,
+			std::function<BoxOccupancyFn> boxOccupancyFunction,
+			std::function<ShouldSubdivideFn> shouldSubdivideFunction,
+			std::function<GetSubdividedVolumeForChildFn> getSubdividedVolumeForChildFunction )
+		{
+			Initialise( volume, intersectsBoxFunction, boxOccupancyFunction, shouldSubdivideFunction, getSubdividedVolumeForChildFunction );
+		}
+
+		void Initialise( const boundingVolumeType& volume, Policy treePolicy = Policy() )
+		{
+			boundingVolume = volume;
+			policy = std::move( treePolicy );
+		}
+
+		// Only for NTreeFunctionPolicy
+		void Initialise( const boundingVolumeType& volume, std::function<IntersectsBoxFn> intersectsBoxFunction,
+			std::function<BoxOccupancyFn> boxOccupancyFunction,
+			std::function<ShouldSubdivideFn> shouldSubdivideFunction,
+			std::function<GetSubdividedVolumeForChildFn> getSubdividedVolumeForChildFunction )
+		{
+			static_assert( std::is_same_v<Policy, FunctionPolicy>, "Only trees with NTreeFunctionPolicy take functions" );
+			boundingVolume = volume;
+			policy.intersectsBox = intersectsBoxFunction;
+			policy.occupiesBox = boxOccupancyFunction;
+			policy.shouldSubdivide = shouldSubdivideFunction;
+			policy.getSubdividedVolumeForChild = getSubdividedVolumeForChildFunction;
+		}
+
+		// Add a single element into the tree
+		void AddElement( const elementType& element )
+		{
+			elements.push_back( element );
+		}
+
+		// Add elements into the tree
+		void AddElements( const Vector<elementType>& elementList )
+		{
+			elements.insert( elements.end(), elementList.begin(), elementList.end() );
+		}
+
+		// Move the elements into the tree
+		void SetElements( Vector<elementType>&& elementList )
+		{
+			elements = std::move( elementList );
+		}
+
+		// Subtrees with fewer elements than this aren't worth handing off to another thread
+		static constexpr uint32_t ParallelMinElements = 16384U;
+
+		// Rebuild the tree
+		// @param numThreads: how many threads build the subtrees, 0 means one per hardware thread
+		// The nodes end up exactly the same no matter how many threads were used
+		// With more than one, the policy's functions are called from several threads at once,
+		// so they mustn't change anything they share, e.g. the std::functions of NTreeFunctionPolicy
+		// have to be safe to call concurrently, which plain functions like the ones in utils are
+		// If one of them throws, the exception comes out of here once the other threads are done
+		void Rebuild( size_t numThreads = 1U )
+		{
+			if ( numThreads == 1U || elements.size() < ParallelMinElements )
+			{
+				Build( nullptr );
+				return;
+			}
+
+			TaskPool pool( numThreads );
+			Build( &pool );
+		}
+
+		// Same as above, with the caller's pool, so its threads are kept between rebuilds
+		void Rebuild( TaskPool& pool )
+		{
+			Build( &pool );
+		}
+
+		// Rebuild a point octree from Morton codes, which is a lot quicker than Rebuild for big point clouds
+		// The points are radix-sorted along a Z-order curve, so every node's elements are already next to
+		// each other and no point is tested against a child's box, the nodes are laid out like Rebuild does it
+		// GetNodes and GetLeaves come out the same as after Rebuild, unless it would go deeper than this can,
+		// but the element indices within each node are in Morton order, so they can be in a different order
+		// Only for Vec3 elements, and the policy has to split nodes in the middle like utils::GetAABBForChild
+		// @param maxSubdivisions: how many levels the tree can have below the root, at most 21,
+		// up to 10 uses 30-bit codes, which are quicker to sort than 63-bit ones
+		void RebuildLinear( uint32_t maxSubdivisions = 10U )
+		{
+			static_assert( std::is_same_v<elementType, Vec3> && std::is_same_v<boundingVolumeType, AABB> && Dimensions == 3U,
+				"RebuildLinear only works for point octrees" );
+
+			if ( maxSubdivisions <= 10U )
+			{
+				BuildLinear<uint32_t>( maxSubdivisions );
+			}
+			else
+			{
+				BuildLinear<uint64_t>( std::min( maxSubdivisions, 21U ) );
+			}
+
+			FindLeaves();
+		}
+
+	public: // Some getters'n'stuff
+		const Vector<elementType>& GetElements() const
+		{
+			return elements;
+		}
+
+		const boundingVolumeType& GetBoundingVolume() const
+		{
+			return boundingVolume;
+		}
+
+		const Policy& GetPolicy() const
+		{
+			return policy;
+		}
+
+		// The root node comes first
+		const Vector<NodeType>& GetNodes() const
+		{
+			return nodes;
+		}
+
+		// Indices of nodes that have no children, but have elements
+		const Vector<uint32_t>& GetLeaves() const
+		{
+			return leaves;
+		}
+
+		// Indices into GetElements, each node refers to a range of them
+		const Vector<uint32_t>& GetElementIndices() const
+		{
+			return elementIndices;
+		}
+
+		const NodeType& GetNode( uint32_t index ) const
+		{
+			return nodes[index];
+		}
+
+		// How many levels of nodes there are, the root alone is 1
+		uint32_t GetDepth() const
+		{
+			return depth;
+		}
+
+		// Calls function( const NodeType& ) for each child of the node, if it has any
+		template<typename Function>
+		void ForEachChild( const NodeType& node, Function&& function ) const
+		{
+			if ( !node.HasChildren() )
+			{
+				return;
+			}
+
+			for ( uint32_t i = 0U; i < Combinations; i++ )
+			{
+				function( nodes[node.firstChild + i] );
+			}
+		}
+
+		// Calls function( const elementType& ) for each element in the node's subtree
+		template<typename Function>
+		void ForEachElement( const NodeType& node, Function&& function ) const
+		{
+			const uint32_t* indices = elementIndices.data() + node.firstElement;
+			for ( uint32_t i = 0U; i < node.numElements; i++ )
+			{
+				function( elements[indices[i]] );
+			}
+		}
+
+	public: // Queries
+		// These need an AABB bounding volume, so they work with Octree
+		// 
+		// Results are indices into GetElements, appended to the caller's
+		// vector, which can be reused between queries to not allocate
+		// Elements are only looked for in the node they were put into, so
+		// if they can stick out of it, e.g. boxes, or points that rays hit
+		// as spheres, set an element margin to grow the nodes by that much
+		// 
+		// Elements of nodes that are completely inside the query are added
+		// without testing them, the rest are tested by the element test
+
+		// How far elements can stick out of the node they are put into,
+		// queries treat nodes as this much bigger on all sides
+		void SetElementMargin( float margin )
+		{
+			elementMargin = margin;
+		}
+
+		float GetElementMargin() const
+		{
+			return elementMargin;
+		}
+
+		// Finds elements that overlap the box, tested with the tree's intersection function
+		// @returns How many were added to the results
+		size_t QueryBox( const AABB& box, Vector<uint32_t>& results ) const
+		{
+			return QueryBox( box, results, [this]( const elementType& element, const AABB& box )
+				{
+					return policy.IntersectsBox( element, box );
+				} );
+		}
+
+		// Same as above, with an element test: bool( const elementType&, const AABB& )
+		template<typename ElementTest>
+		size_t QueryBox( const AABB& box, Vector<uint32_t>& results, ElementTest&& test ) const
+		{
+			return Query( results,
+				[&]( const AABB& volume )
+				{
+					if ( !box.Intersects( volume ) )
+					{
+						return Overlap::Outside;
+					}
+
+					return box.Contains( volume ) ? Overlap::Inside : Overlap::Partial;
+				},
+				[&]( const elementType& element )
+				{
+					return test( element, box );
+				} );
+		}
+
+		// Finds elements that overlap the sphere
+		// Element test: bool( const elementType&, const Vec3& centre, float radius ), e.g. utils::PointInSphere
+		// @returns How many were added to the results
+		template<typename ElementTest>
+		size_t QuerySphere( const Vec3& centre, float radius, Vector<uint32_t>& results, ElementTest&& test ) const
+		{
+			const float radiusSquared = radius * radius;
+			return Query( results,
+				[&]( const AABB& volume )
+				{
+					// The closest and farthest points of the box from the centre
+					float closest = 0.0f;
+					float farthest = 0.0f;
+					for ( uint32_t axis = 0U; axis < 3U; axis++ )
+					{
+						const float toMins = centre[axis] - volume.mins[axis];
+						const float toMaxs = volume.maxs[axis] - centre[axis];
+						const float outside = std::max( std::max( -toMins, -toMaxs ), 0.0f );
+						const float inside = std::max( std::fabs( toMins ), std::fabs( toMaxs ) );
+						closest += outside * outside;
+						farthest += inside * inside;
+					}
+
+					if ( closest > radiusSquared )
+					{
+						return Overlap::Outside;
+					}
+
+					return farthest <= radiusSquared ? Overlap::Inside : Overlap::Partial;
+				},
+				[&]( const elementType& element )
+				{
+					return test( element, centre, radius );
+				} );
+		}
+
+		// Finds elements inside a convex volume made of planes whose normals point inwards
+		// Element test: bool( const elementType&, const Plane* planes, size_t numPlanes ), e.g. utils::PointInPlanes
+		// @returns How many were added to the results
+		template<typename ElementTest>
+		size_t QueryFrustum( const Plane* planes, size_t numPlanes, Vector<uint32_t>& results, ElementTest&& test ) const
+		{
+			return Query( results,
+				[&]( const AABB& volume )
+				{
+					Overlap overlap = Overlap::Inside;
+					for ( size_t i = 0U; i < numPlanes; i++ )
+					{
+						// The box's corners the farthest along the normal, and against it
+						const Plane& plane = planes[i];
+						const Vec3 front( plane.a >= 0.0f ? volume.maxs.x : volume.mins.x,
+							plane.b >= 0.0f ? volume.maxs.y : volume.mins.y,
+							plane.c >= 0.0f ? volume.maxs.z : volume.mins.z );
+						if ( plane.EvalAtPoint( front ) < 0.0f )
+						{
+							return Overlap::Outside;
+						}
+
+						const Vec3 back( plane.a >= 0.0f ? volume.mins.x : volume.maxs.x,
+							plane.b >= 0.0f ? volume.mins.y : volume.maxs.y,
+							plane.c >= 0.0f ? volume.mins.z : volume.maxs.z );
+						if ( plane.EvalAtPoint( back ) < 0.0f )
+						{
+							overlap = Overlap::Partial;
+						}
+					}
+
+					return overlap;
+				},
+				[&]( const elementType& element )
+				{
+					return test( element, planes, numPlanes );
+				} );
+		}
+
+		// Same as above, with the frustum of a view-projection matrix, see Plane::FrustumFromViewProjection
+		template<typename ElementTest>
+		size_t QueryFrustum( const Mat4& viewProjection, Vector<uint32_t>& results, ElementTest&& test ) const
+		{
+			const Array<Plane, 6> planes = Plane::FrustumFromViewProjection( viewProjection );
+			return QueryFrustum( planes.data(), planes.size(), results, test );
+		}
+
+		// Finds the element closest to the start of the segment that it hits
+		// Nodes are visited front to back, and ones that start past the
+		// closest hit so far are skipped, so it usually stops early
+		// Element test: bool( const elementType&, const Vec3& start, const Vec3& end, float& outFraction ),
+		// where the fraction goes from 0 at the start to 1 at the end, e.g. utils::PointRayTest
+		// @returns False if nothing was hit, otherwise the element index and fraction are written
+		template<typename ElementTest>
+		bool RayCast( const Vec3& start, const Vec3& end, ElementTest&& test, uint32_t& outElement, float& outFraction ) const
+		{
+			if ( nodes.empty() || nodes[0].IsEmpty() )
+			{
+				return false;
+			}
+
+			const Vec3 direction = end - start;
+			const Vec3 inverseDirection( 1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z );
+			float closest = 1.0f;
+			bool hit = false;
+
+			// @returns Where the segment enters the box, or more than closest if it misses
+			const auto enter = [&]( const AABB& volume )
+			{
+				float entry = 0.0f;
+				float exit = closest;
+				for ( uint32_t axis = 0U; axis < 3U; axis++ )
+				{
+					float t1 = (volume.mins[axis] - start[axis]) * inverseDirection[axis];
+					float t2 = (volume.maxs[axis] - start[axis]) * inverseDirection[axis];
+					// A segment parallel to the slab is either always or never in it
+					if ( direction[axis] == 0.0f )
+					{
+						if ( start[axis] < volume.mins[axis] || start[axis] > volume.maxs[axis] )
+						{
+							return FLT_MAX;
+						}
+
+						continue;
+					}
+
+					if ( t1 > t2 )
+					{
+						std::swap( t1, t2 );
+					}
+
+					entry = std::max( entry, t1 );
+					exit = std::min( exit, t2 );
+				}
+
+				return entry <= exit ? entry : FLT_MAX;
+			};
+
+			NodeStack stack( depth * (Combinations - 1U) + 1U );
+			stack.Push( 0U );
+			while ( !stack.IsEmpty() )
+			{
+				const NodeType& node = nodes[stack.Pop()];
+				if ( enter( GetQueryVolume( node ) ) > closest )
+				{
+					continue;
+				}
+
+				if ( !node.HasChildren() )
+				{
+					const uint32_t* indices = elementIndices.data() + node.firstElement;
+					for ( uint32_t i = 0U; i < node.numElements; i++ )
+					{
+						float fraction = closest;
+						if ( test( elements[indices[i]], start, end, fraction ) && fraction >= 0.0f && fraction <= closest )
+						{
+							closest = fraction;
+							outElement = indices[i];
+							hit = true;
+						}
+					}
+
+					continue;
+				}
+
+				// Push the children that are hit, farthest first, so the nearest is popped first
+				float childEnter[Combinations];
+				uint32_t order[Combinations];
+				uint32_t numHit = 0U;
+				for ( uint32_t child = 0U; child < Combinations; child++ )
+				{
+					const NodeType& childNode = nodes[node.firstChild + child];
+					if ( childNode.IsEmpty() )
+					{
+						continue;
+					}
+
+					const float t = enter( GetQueryVolume( childNode ) );
+					if ( t > closest )
+					{
+						continue;
+					}
+
+					// Insertion sort, there are only a few
+					uint32_t at = numHit++;
+					for ( ; at > 0U && childEnter[at - 1U] < t; at-- )
+					{
+						childEnter[at] = childEnter[at - 1U];
+						order[at] = order[at - 1U];
+					}
+					childEnter[at] = t;
+					order[at] = node.firstChild + child;
+				}
+
+				for ( uint32_t i = 0U; i < numHit; i++ )
+				{
+					stack.Push( order[i] );
+				}
+			}
+
+			if ( hit )
+			{
+				outFraction = closest;
+			}
+
+			return hit;
+		}
+
+	private:
+		enum class Overlap
+		{
+			Outside,
+			Partial,
+			Inside
+		};
+
+		// Node indices waiting to be visited, the tree's depth says how
+		// many there can be at most, usually few enough to not allocate
+		class NodeStack final
+		{
+		public:
+			NodeStack( size_t capacity )
+			{
+				if ( capacity > InlineCapacity )
+				{
+					heapNodes.resize( capacity );
+					data = heapNodes.data();
+				}
+			}
+
+			void Push( uint32_t node )
+			{
+				data[size++] = node;
+			}
+
+			uint32_t Pop()
+			{
+				return data[--size];
+			}
+
+			bool IsEmpty() const
+			{
+				return size == 0U;
+			}
+
+		private:
+			static constexpr size_t InlineCapacity = 256U;
+			uint32_t inlineNodes[InlineCapacity];
+			Vector<uint32_t> heapNodes;
+			uint32_t* data{ inlineNodes };
+			size_t size{ 0U };
+		};
+
+		// The node's volume, grown by the element margin
+		AABB GetQueryVolume( const NodeType& node ) const
 		{
+			if ( elementMargin <= 0.0f )
+			{
+				return node.boundingVolume;
+			}
+
+			return AABB( node.boundingVolume.mins - Vec3( elementMargin ), node.boundingVolume.maxs + Vec3( elementMargin ) );
+		}
+
+		// Walks the tree with classify( const AABB& ) -> Overlap, adding the
+		// elements of nodes inside, and the ones that pass test( element )
+		// from leaves that are partially inside
+		template<typename Classify, typename ElementTest>
+		size_t Query( Vector<uint32_t>& results, Classify&& classify, ElementTest&& test ) const
+		{
+			const size_t numResults = results.size();
+			if ( nodes.empty() || nodes[0].IsEmpty() )
+			{
+				return 0U;
+			}
+
+			NodeStack stack( depth * (Combinations - 1U) + 1U );
+			stack.Push( 0U );
+			while ( !stack.IsEmpty() )
+			{
+				const NodeType& node = nodes[stack.Pop()];
+				const Overlap overlap = classify( GetQueryVolume( node ) );
+				if ( overlap == Overlap::Outside )
+				{
+					continue;
+				}
+
+				const uint32_t* indices = elementIndices.data() + node.firstElement;
+				if ( overlap == Overlap::Inside )
+				{
+					results.insert( results.end(), indices, indices + node.numElements );
+				}
+				else if ( !node.HasChildren() )
+				{
+					for ( uint32_t i = 0U; i < node.numElements; i++ )
+					{
+						if ( test( elements[indices[i]] ) )
+						{
+							results.push_back( indices[i] );
+						}
+					}
+				}
+				else
+				{
+					for ( uint32_t child = 0U; child < Combinations; child++ )
+					{
+						if ( !nodes[node.firstChild + child].IsEmpty() )
+						{
+							stack.Push( node.firstChild + child );
+						}
+					}
+				}
+			}
+
+			return results.size() - numResults;
 		}
 
-		NTreeNode( const boundingVolumeType& boundingVolume, const Vector<elementType>& elementList )
-			: boundingVolume( boundingVolume )
+		// A subtree that was handed off to the task pool, see Rebuild
+		struct BuildTask
+		{
+			// A subtree this one handed off in turn
+			struct Split
+			{
+				// How many of the task's nodes a serial build would make before the subtree, not counting the root
+				uint32_t position;
+				// The subtree's root, counting from the task's root
+				uint32_t node;
+				UniquePtr<BuildTask> task;
+			};
+
+			// The task starts off with a copy of its root node
+			NodeType root;
+			uint32_t rootDepth{ 1U };
+			// The task's nodes are next to each other in one worker's arena, the root first
+			size_t worker{ 0U };
+			uint32_t arenaStart{ 0U };
+			uint32_t numNodes{ 0U };
+			// How deep the task went, and how many nodes its subtree has in the end
+			uint32_t depth{ 1U };
+			uint32_t numSubtreeNodes{ 0U };
+			// In the order a serial build would have gone down into them
+			Vector<Split> splits;
+		};
+
+		// What BuildNode works with, the pool is null for a serial build
+		struct BuildContext
+		{
+			// Where the new nodes go, the tree's own ones for a serial build
+			Vector<NodeType>& arena;
+			// Room for sorting the element indices, see Rebuild
+			Vector<uint32_t>& scratch;
+			// The deepest level reached so far
+			uint32_t depth;
+
+			TaskPool* pool{ nullptr };
+			size_t worker{ 0U };
+			BuildTask* task{ nullptr };
+			Vector<Vector<NodeType>>* arenas{ nullptr };
+		};
+
+		// See Rebuild, the pool is null for a serial build
+		void Build( TaskPool* pool )
 		{
-			numElements = elementList.size();
-			for ( const auto& element : elementList )
+			// Clear the tree and put the root node in
+			leaves.clear();
+			nodes.clear();
+			elementIndices.clear();
+			depth = 1U;
+			nodes.emplace_back( boundingVolume );
+
+			// No elements, root node is empty
+			if ( elements.empty() )
 			{
-				elements.push_back( element );
+				return;
 			}
-		}
 
-		NTreeNode( const boundingVolumeType& boundingVolume, const LinkedList<elementType>& elementList )
-			: boundingVolume( boundingVolume ), elements( elementList )
-		{
-			for ( const auto& element : elements )
+			// Fill it with all elements
+			elementIndices.reserve( elements.size() );
+			for ( uint32_t i = 0U; i < elements.size(); i++ )
 			{
-				numElements++;
+				if ( policy.IntersectsBox( elements[i], boundingVolume ) )
+				{
+					elementIndices.push_back( i );
+				}
 			}
-		}
-
-		void AddElement( elementType element )
-		{
-			elements.push_back( element );
-			numElements++;
-		}
+			nodes[0].numElements = uint32_t( elementIndices.size() );
 
-		void CreateChildren( LinkedList<NTreeNode<elementType, boundingVolumeType, Dimensions>>& octreeNodes, std::function<GetSubdividedVolumeForChildFn> getSubdividedVolumeForChild )
-		{
-			for ( uint32_t i = 0; i < Combinations; i++ )
+			// Recursively subdivide the tree, with room to sort the indices
+			// Every node has its own range of it, so threads can share it
+			Vector<uint32_t> scratch( elementIndices.size() * 2U );
+			if ( nullptr == pool || pool->GetNumThreads() == 1U || elementIndices.size() < ParallelMinElements )
 			{
-				auto& child = children[i];
-				child = &octreeNodes.emplace_back( getSubdividedVolumeForChild( boundingVolume, i ) );
+				BuildContext context{ nodes, scratch, depth };
+				BuildNode( context, 0U, 1U );
+				depth = context.depth;
 			}
-
-			// Become a non-leaf because you have children now
-			if ( IsLeaf() )
+			else
 			{
-				numElements *= -1;
+				BuildParallel( *pool, scratch );
 			}
-		}
 
-		bool IsLeaf() const
-		{
-			return numElements > 0;
+			// Now that the tree is built, find all leaf nodes
+			FindLeaves();
 		}
 
-		bool IsEmpty() const
+		// Builds the tree with a task per big subtree, every worker puts its nodes into its own arena,
+		// and the arenas are stitched together at the end in the order a serial build would go in
+		void BuildParallel( TaskPool& pool, Vector<uint32_t>& scratch )
 		{
-			return numElements == 0;
-		}
+			Vector<Vector<NodeType>> arenas( pool.GetNumThreads() );
 
-		const boundingVolumeType& GetBoundingVolume() const
-		{
-			return boundingVolume;
-		}
+			BuildTask rootTask;
+			rootTask.root = nodes[0];
+			pool.Run( [&]( size_t worker )
+			{
+				RunBuildTask( rootTask, pool, arenas, scratch, worker );
+			} );
 
-		int32_t GetNumElements() const
-		{
-			return numElements;
+			nodes.resize( CountBuildTaskNodes( rootTask ) + 1U );
+			MergeBuildTask( rootTask, arenas, 0U, 1U );
 		}
 
-		void ForEachChild( std::function<ForEachChildFn> function ) const
+		// Recursively build octree nodes
+		// The node's elements are sorted by which child they go into,
+		// so that each child ends up with a range of its parent's
+		void BuildNode( BuildContext& context, uint32_t nodeIndex, uint32_t nodeDepth )
 		{
-			if ( IsLeaf() )
+			Vector<NodeType>& nodes = context.arena;
+
+			// Node is a leaf, bail out
+			if ( !policy.ShouldSubdivide( nodes[nodeIndex] ) )
 			{
 				return;
 			}
 
-			for ( auto& child : children )
+			context.depth = std::max( context.depth, nodeDepth + 1U );
+
+			// The node can be subdivided, create the child nodes
+			const uint32_t firstChild = uint32_t( nodes.size() );
+			for ( uint32_t i = 0U; i < Combinations; i++ )
 			{
-				function( child );
+				nodes.emplace_back( policy.GetSubdividedVolumeForChild( nodes[nodeIndex].boundingVolume, i ) );
 			}
-		}
 
-		void ForEachElement( std::function<ForEachElementFn> function ) const
-		{
-			for ( auto& element : elements )
+			NodeType& node = nodes[nodeIndex];
+			node.firstChild = firstChild;
+			uint32_t* indices = elementIndices.data() + node.firstElement;
+
+			// Figure out which element belongs to which node, the ones
+			// that don't intersect any of the children are left out
+			constexpr uint32_t LeftOut = Combinations;
+			uint32_t childCounts[Combinations + 1]{};
+			uint32_t* belongsTo = context.scratch.data() + node.firstElement;
+			for ( uint32_t i = 0U; i < node.numElements; i++ )
 			{
-				function( element );
-			}
-		}
+				const elementType& element = elements[indices[i]];
 
-	private:
-		boundingVolumeType boundingVolume{};
-		// > 0 -> leaf
-		// = 0 -> empty
-		// < 0 -> node with children
-		int32_t numElements{ 0 };
-		LinkedList<elementType> elements;
+				// If the element is non-point and intersects with multiple
+				// nodes, determine which one it'll ultimately belong to
+				uint32_t belongingChild = LeftOut;
+				uint32_t numIntersections = 0U;
+				float maxOccupancy = -99999.0f;
+				for ( uint32_t child = 0U; child < Combinations; child++ )
+				{
+					const auto& childVolume = nodes[firstChild + child].boundingVolume;
+					if ( !policy.IntersectsBox( element, childVolume ) )
+					{
+						continue;
+					}
 
-		NTreeNode* children[Combinations]{};
-	};
+					numIntersections++;
 
-	// Non-copyable quadtree node
-	//template<typename elementType>
-	//using QuadtreeNode = NTreeNode<elementType, Rect, 2>;
+					// It is only in one node so far, or an occupancy function
+					// wasn't provided, don't bother checking spatial occupancy
+					if ( numIntersections == 1U )
+					{
+						belongingChild = child;
+						if ( !policy.HasOccupancy() )
+						{
+							break;
+						}
 
-	// Non-copyable octree node
-	template<typename elementType>
-	using OctreeNode = NTreeNode<elementType, AABB, 3>;
+						continue;
+					}
 
-	// Non-copyable N-dimensional tree designed to host static elements
-	template<typename elementType, typename boundingVolumeType, size_t Dimensions>
-	class NTree
-	{
-	public:
-		using NodeType = NTreeNode<elementType*, boundingVolumeType, Dimensions>;
-		static constexpr size_t Combinations = 1 << Dimensions;
+					// Calculate surface area or volume inside each node
+					if ( numIntersections == 2U )
+					{
+						maxOccupancy = policy.OccupiesBox( element, nodes[firstChild + belongingChild].boundingVolume );
+					}
 
-		// Does the element intersect an AABB?
-		using IntersectsBoxFn = bool( const elementType& element, const AABB& boundingVolume );
-		// If this is a non-point, how much of it is inside this box?
-		// Returned value can be any
-		using BoxOccupancyFn = float( const elementType& element, const AABB& boundingVolume );
-		// With these elements loaded, should this node subdivide any further?
-		using ShouldSubdivideFn = bool( const NodeType& );
-		// Get a subdivided bounding volume for the Nth child node
-		using GetSubdividedVolumeForChildFn = boundingVolumeType( boundingVolumeType, size_t );
+					const float occupancy = policy.OccupiesBox( element, childVolume );
+					if ( occupancy > maxOccupancy )
+					{
+						belongingChild = child;
+						maxOccupancy = occupancy;
+					}
+				}
 
-	public:
-		NTree() = default;
-		NTree( const NTree& octree ) = delete;
-		NTree( NTree&& octree ) = default;
-		NTree& operator=( NTree&& octree ) = default;
+				belongsTo[i] = belongingChild;
+				childCounts[belongingChild]++;
+			}
 
-		NTree( const boundingVolumeType& volume, std::function<IntersectsBoxFn> intersectsBoxFunction,
-			std::function<BoxOccupancyFn> boxOccupancyFunction,
-			std::function<ShouldSubdivideFn> shouldSubdivideFunction,
-			std::function<GetSubdividedVolumeForChildFn> getSubdividedVolumeForChildFunction )
-		{
-			Initialise( volume, intersectsBoxFunction, boxOccupancyFunction, shouldSubdivideFunction, getSubdividedVolumeForChildFunction );
-		}
+			// Sort the indices by child, into the second half of the scratch space
+			uint32_t childOffsets[Combinations + 1]{};
+			for ( uint32_t child = 1U; child <= Combinations; child++ )
+			{
+				childOffsets[child] = childOffsets[child - 1U] + childCounts[child - 1U];
+			}
 
-		void Initialise( const boundingVolumeType& volume, std::function<IntersectsBoxFn> intersectsBoxFunction,
-			std::function<BoxOccupancyFn> boxOccupancyFunction,
-			std::function<ShouldSubdivideFn> shouldSubdivideFunction,
-			std::function<GetSubdividedVolumeForChildFn> getSubdividedVolumeForChildFunction )
-		{
-			boundingVolume = volume;
-			intersectsBox = intersectsBoxFunction;
-			occupiesBox = boxOccupancyFunction;
-			shouldSubdivide = shouldSubdivideFunction;
-			getSubdividedVolumeForChild = getSubdividedVolumeForChildFunction;
-		}
+			uint32_t* sorted = belongsTo + elementIndices.size();
+			for ( uint32_t i = 0U; i < node.numElements; i++ )
+			{
+				sorted[childOffsets[belongsTo[i]]++] = indices[i];
+			}
+			std::copy( sorted, sorted + node.numElements, indices );
 
-		// Add a single element into the tree
-		void AddElement( const elementType& element )
-		{
-			elements.push_back( element );
+			uint32_t firstElement = node.firstElement;
+			for ( uint32_t child = 0U; child < Combinations; child++ )
+			{
+				NodeType& childNode = nodes[firstChild + child];
+				childNode.firstElement = firstElement;
+				childNode.numElements = childCounts[child];
+				firstElement += childCounts[child];
+			}
+			node.numElements -= childCounts[LeftOut];
+
+			// Now that we've done the heavy work, go down the tree,
+			// the big subtrees are left to the task pool if there is one
+			for ( uint32_t child = 0U; child < Combinations; child++ )
+			{
+				if ( nullptr != context.pool && childCounts[child] >= ParallelMinElements )
+				{
+					SpawnBuildTask( context, firstChild + child, nodeDepth + 1U );
+				}
+				else
+				{
+					BuildNode( context, firstChild + child, nodeDepth + 1U );
+				}
+			}
 		}
 
-		// Add elements into the tree
-		void AddElements( const Vector<elementType>& elementList )
+		// Hands the subtree of a node off to the task pool
+		void SpawnBuildTask( BuildContext& context, uint32_t nodeIndex, uint32_t nodeDepth )
 		{
-			elements.insert( elements.end(), elementList.begin(), elementList.end() );
+			BuildTask& parent = *context.task;
+			UniquePtr<BuildTask> task = std::make_unique<BuildTask>();
+			task->root = context.arena[nodeIndex];
+			task->rootDepth = nodeDepth;
+
+			// A serial build would put the subtree right after the nodes made so far
+			BuildTask* spawned = task.get();
+			const uint32_t position = uint32_t( context.arena.size() ) - parent.arenaStart - 1U;
+			parent.splits.push_back( { position, nodeIndex - parent.arenaStart, std::move( task ) } );
+
+			TaskPool* pool = context.pool;
+			Vector<Vector<NodeType>>* arenas = context.arenas;
+			Vector<uint32_t>* scratch = &context.scratch;
+			pool->Spawn( context.worker, [this, spawned, pool, arenas, scratch]( size_t worker )
+			{
+				RunBuildTask( *spawned, *pool, *arenas, *scratch, worker );
+			} );
 		}
 
-		// Move the elements into the tree
-		void SetElements( Vector<elementType>&& elementList )
+		// Builds the subtree of a task's root into the worker's arena
+		void RunBuildTask( BuildTask& task, TaskPool& pool, Vector<Vector<NodeType>>& arenas, Vector<uint32_t>& scratch, size_t worker )
 		{
-			elements = std::move( elementList );
+			// A worker only runs one task at a time, so the
+			// task's nodes end up next to each other in its arena
+			Vector<NodeType>& arena = arenas[worker];
+			task.worker = worker;
+			task.arenaStart = uint32_t( arena.size() );
+			arena.push_back( task.root );
+
+			BuildContext context{ arena, scratch, task.rootDepth, &pool, worker, &task, &arenas };
+			BuildNode( context, task.arenaStart, task.rootDepth );
+
+			task.numNodes = uint32_t( arena.size() ) - task.arenaStart;
+			task.depth = context.depth;
 		}
 
-		// Recursively build octree nodes
-		void BuildNode( NodeType* node )
+		// @returns How many nodes the task's subtree has, its root not included
+		static uint32_t CountBuildTaskNodes( BuildTask& task )
 		{
-			// Node is a leaf, bail out
-			if ( !shouldSubdivide( *node ) )
+			task.numSubtreeNodes = task.numNodes - 1U;
+			for ( auto& split : task.splits )
 			{
-				return;
+				task.numSubtreeNodes += CountBuildTaskNodes( *split.task );
 			}
 
-			// The node can be subdivided, create the child nodes
-			// and figure out which element belongs to which node
-			node->CreateChildren( nodes, getSubdividedVolumeForChild );
-			node->ForEachElement( [&]( elementType* element )
-				{
-					// If the element is non-point and intersects with multiple
-					// nodes, determine which one it'll ultimately belong to
-					Vector<NodeType*> intersectingNodes;
-					intersectingNodes.reserve( Combinations );
-					node->ForEachChild( [&]( NodeType* child )
-						{
-							if ( intersectsBox( *element, child->GetBoundingVolume() ) )
-							{
-								intersectingNodes.push_back( child );
-							}
-						} );
-					// No intersections at all, bail out
-					if ( intersectingNodes.empty() )
-					{
-						return;
-					}
+			return task.numSubtreeNodes;
+		}
 
-					// It is only in one node, or an occupancy function
-					// wasn't provided, don't bother checking spatial occupancy
-					if ( intersectingNodes.size() == 1U || !occupiesBox )
-					{
-						intersectingNodes.front()->AddElement( element );
-						return;
-					}
+		// Copies the nodes of a task and the ones it spawned into
+		// the tree, exactly where a serial build would have put them
+		// @param rootIndex: where the task's root goes
+		// @param firstIndex: where the rest of its subtree starts
+		void MergeBuildTask( const BuildTask& task, const Vector<Vector<NodeType>>& arenas, uint32_t rootIndex, uint32_t firstIndex )
+		{
+			// Figure out where each of the task's nodes goes, with the
+			// spawned subtrees in between, so child indices can be remapped
+			Vector<uint32_t> nodeIndices( task.numNodes );
+			Vector<uint32_t> splitIndices( task.splits.size() );
+			nodeIndices[0] = rootIndex;
 
-					// Calculate surface area or volume inside each node
-					NodeType* belongingNode = intersectingNodes.front();
-					float maxOccupancy = -99999.0f;
-					for ( auto& intersectingNode : intersectingNodes )
-					{
-						float occupancy = occupiesBox( *element, intersectingNode->GetBoundingVolume() );
-						if ( occupancy > maxOccupancy )
-						{
-							belongingNode = intersectingNode;
-							maxOccupancy = occupancy;
-						}
-					}
+			uint32_t nextIndex = firstIndex;
+			size_t split = 0U;
+			for ( uint32_t i = 1U; i <= task.numNodes; i++ )
+			{
+				for ( ; split < task.splits.size() && task.splits[split].position == i - 1U; split++ )
+				{
+					splitIndices[split] = nextIndex;
+					nextIndex += task.splits[split].task->numSubtreeNodes;
+				}
 
-					// Finally, add the thing
-					belongingNode->AddElement( element );
-				} );
+				if ( i < task.numNodes )
+				{
+					nodeIndices[i] = nextIndex++;
+				}
+			}
 
-			// Now that we've done the heavy work, go down the tree
-			node->ForEachChild( [&]( NodeType* child )
+			const NodeType* taskNodes = arenas[task.worker].data() + task.arenaStart;
+			for ( uint32_t i = 0U; i < task.numNodes; i++ )
+			{
+				NodeType& node = nodes[nodeIndices[i]];
+				node = taskNodes[i];
+				if ( node.firstChild != NodeType::NoChildren )
 				{
-					BuildNode( child );
-				} );
+					node.firstChild = nodeIndices[node.firstChild - task.arenaStart];
+				}
+			}
+
+			depth = std::max( depth, task.depth );
+
+			// The spawned subtrees overwrite their roots with their own copies
+			for ( size_t i = 0U; i < task.splits.size(); i++ )
+			{
+				const auto& taskSplit = task.splits[i];
+				MergeBuildTask( *taskSplit.task, arenas, nodeIndices[taskSplit.node], splitIndices[i] );
+			}
 		}
 
-		// Rebuild the tree
-		void Rebuild()
+		// Clears the tree and puts the points into it, sorted by Morton code, see RebuildLinear
+		// Every level of the tree takes 3 bits of the code, x being the highest, same as the child indices
+		template<typename CodeType>
+		void BuildLinear( uint32_t levels )
 		{
-			// Clear the tree and put the root node in
 			leaves.clear();
 			nodes.clear();
-			auto& node = nodes.emplace_back( boundingVolume );
+			elementIndices.clear();
+			depth = 1U;
+			nodes.emplace_back( boundingVolume );
 
-			// No elements, root node is empty
 			if ( elements.empty() )
 			{
 				return;
 			}
 
-			// Fill it with all elements
-			for ( auto& element : elements )
+			// Snap the points to a grid as fine as the deepest level, in double precision,
+			// or else points close to a split would get rounded onto the other side of it
+			// Points right on a split go to the lower cell, like they go into the first child with Rebuild
+			const double maxCell = double( (1U << levels) - 1U );
+			const auto toCell = [maxCell]( float coordinate, float mins, float maxs )
 			{
-				if ( intersectsBox( element, boundingVolume ) )
-				{
-					node.AddElement( &element );
-				}
-			}
+				const double size = double( maxs ) - double( mins );
+				const double cell = size > 0.0 ? (double( coordinate ) - double( mins )) * (maxCell + 1.0) / size : 0.0;
+				return uint32_t( std::min( std::max( std::ceil( cell ) - 1.0, 0.0 ), maxCell ) );
+			};
 
-			// Recursively subdivide the tree
-			BuildNode( &node );
+			const Vec3& mins = boundingVolume.mins;
+			const Vec3& maxs = boundingVolume.maxs;
 
-			// Now that the tree is built, find all leaf nodes
-			for ( auto& node : nodes )
+			Vector<CodeType> codes;
+			codes.reserve( elements.size() );
+			elementIndices.reserve( elements.size() );
+			for ( uint32_t i = 0U; i < elements.size(); i++ )
 			{
-				if ( node.IsLeaf() )
+				const Vec3& point = elements[i];
+				if ( !boundingVolume.IsInside( point ) )
 				{
-					leaves.push_back( &node );
+					continue;
 				}
+
+				codes.push_back( EncodeMorton<CodeType>( toCell( point.x, mins.x, maxs.x ),
+					toCell( point.y, mins.y, maxs.y ), toCell( point.z, mins.z, maxs.z ) ) );
+				elementIndices.push_back( i );
+			}
+			nodes[0].numElements = uint32_t( elementIndices.size() );
+
+			if ( !codes.empty() )
+			{
+				SortByMortonCode( codes, levels * 3U );
+				BuildLinearNode( codes, 0U, 1U, levels );
 			}
 		}
 
-	public: // Some getters'n'stuff
-		const Vector<elementType>& GetElements() const
+		// Interleaves the bits of the cell coordinates, xyzxyz... from the highest bit down
+		template<typename CodeType>
+		static CodeType EncodeMorton( uint32_t x, uint32_t y, uint32_t z )
 		{
-			return elements;
+			// Spreads the bits out so there are two zeroes after each one
+			const auto spread = []( CodeType value )
+			{
+				if constexpr ( sizeof( CodeType ) == sizeof( uint32_t ) )
+				{
+					value &= 0x3ffU;
+					value = (value | (value << 16U)) & 0x030000ffU;
+					value = (value | (value << 8U)) & 0x0300f00fU;
+					value = (value | (value << 4U)) & 0x030c30c3U;
+					value = (value | (value << 2U)) & 0x09249249U;
+				}
+				else
+				{
+					value &= 0x1fffffU;
+					value = (value | (value << 32U)) & 0x001f00000000ffffULL;
+					value = (value | (value << 16U)) & 0x001f0000ff0000ffULL;
+					value = (value | (value << 8U)) & 0x100f00f00f00f00fULL;
+					value = (value | (value << 4U)) & 0x10c30c30c30c30c3ULL;
+					value = (value | (value << 2U)) & 0x1249249249249249ULL;
+				}
+
+				return value;
+			};
+
+			return (spread( x ) << 2U) | (spread( y ) << 1U) | spread( z );
 		}
 
-		const boundingVolumeType& GetBoundingVolume() const
+		// Sorts the codes and the element indices along with them, 8 bits per pass,
+		// each pass keeps the order of the previous one, so equal codes keep theirs too
+		template<typename CodeType>
+		void SortByMortonCode( Vector<CodeType>& codes, uint32_t numBits )
 		{
-			return boundingVolume;
+			Vector<CodeType> sortedCodes( codes.size() );
+			Vector<uint32_t> sortedIndices( codes.size() );
+			for ( uint32_t shift = 0U; shift < numBits; shift += 8U )
+			{
+				uint32_t offsets[256]{};
+				for ( const CodeType code : codes )
+				{
+					offsets[(code >> shift) & 0xffU]++;
+				}
+
+				// Every code has the same digit here, nothing would move
+				if ( offsets[(codes[0] >> shift) & 0xffU] == codes.size() )
+				{
+					continue;
+				}
+
+				uint32_t offset = 0U;
+				for ( uint32_t& digitOffset : offsets )
+				{
+					const uint32_t count = digitOffset;
+					digitOffset = offset;
+					offset += count;
+				}
+
+				for ( size_t i = 0U; i < codes.size(); i++ )
+				{
+					const uint32_t destination = offsets[(codes[i] >> shift) & 0xffU]++;
+					sortedCodes[destination] = codes[i];
+					sortedIndices[destination] = elementIndices[i];
+				}
+
+				codes.swap( sortedCodes );
+				elementIndices.swap( sortedIndices );
+			}
 		}
 
-		const LinkedList<NodeType>& GetNodes() const
+		// Recursively build octree nodes out of sorted Morton codes, in the same order BuildNode goes in
+		// The elements of each child are already next to each other, their ranges only need to be found
+		template<typename CodeType>
+		void BuildLinearNode( const Vector<CodeType>& codes, uint32_t nodeIndex, uint32_t nodeDepth, uint32_t levels )
 		{
-			return nodes;
+			// Node is a leaf, or the codes can't tell its points apart any further
+			if ( nodeDepth > levels || !policy.ShouldSubdivide( nodes[nodeIndex] ) )
+			{
+				return;
+			}
+
+			depth = std::max( depth, nodeDepth + 1U );
+
+			const uint32_t firstChild = uint32_t( nodes.size() );
+			for ( uint32_t i = 0U; i < Combinations; i++ )
+			{
+				nodes.emplace_back( policy.GetSubdividedVolumeForChild( nodes[nodeIndex].boundingVolume, i ) );
+			}
+
+			NodeType& node = nodes[nodeIndex];
+			node.firstChild = firstChild;
+
+			// This level's 3 bits of the code are the child index
+			const uint32_t shift = (levels - nodeDepth) * 3U;
+			const CodeType* nodeCodes = codes.data() + node.firstElement;
+			const CodeType* nodeCodesEnd = nodeCodes + node.numElements;
+			const CodeType* childCodes = nodeCodes;
+			for ( uint32_t child = 0U; child < Combinations; child++ )
+			{
+				const CodeType* childCodesEnd = std::partition_point( childCodes, nodeCodesEnd, [shift, child]( CodeType code )
+				{
+					return ((code >> shift) & 7U) <= child;
+				} );
+
+				NodeType& childNode = nodes[firstChild + child];
+				childNode.firstElement = node.firstElement + uint32_t( childCodes - nodeCodes );
+				childNode.numElements = uint32_t( childCodesEnd - childCodes );
+				childCodes = childCodesEnd;
+			}
+
+			for ( uint32_t child = 0U; child < Combinations; child++ )
+			{
+				BuildLinearNode( codes, firstChild + child, nodeDepth + 1U, levels );
+			}
 		}
 
-		const Vector<NodeType*>& GetLeaves() const
+		void FindLeaves()
 		{
-			return leaves;
+			for ( uint32_t i = 0U; i < nodes.size(); i++ )
+			{
+				if ( nodes[i].IsLeaf() )
+				{
+					leaves.push_back( i );
+				}
+			}
 		}
 
 	private:
 		// The total bounding volume, equivalent to the bounding volume of the root
 		boundingVolumeType boundingVolume;
-		// Function that returns whether or not an element intersects the bounding volume of a node
-		std::function<IntersectsBoxFn> intersectsBox;
-		// Function that returns how much of the element is occupied by the bounding volume
-		std::function<BoxOccupancyFn> occupiesBox;
-		// Function that does the subdivision heuristic
-		std::function<ShouldSubdivideFn> shouldSubdivide;
-		// Function that subdivides the bounding volume of the parent node for the Nth child node
-		std::function<GetSubdividedVolumeForChildFn> getSubdividedVolumeForChild;
+		// Decides how the tree is built
+		Policy policy;
 		// The elements of this tree
 		Vector<elementType> elements;
-		// A linked list of nodes, contains the root node, its child nodes, child nodes of child nodes etc.
-		LinkedList<NodeType> nodes;
-		// A list of references to nodes that have no children
-		Vector<NodeType*> leaves;
+		// All nodes, the root node first, siblings are next to each other
+		Vector<NodeType> nodes;
+		// Indices into elements, grouped by node
+		Vector<uint32_t> elementIndices;
+		// Indices of nodes that have no children
+		Vector<uint32_t> leaves;
+		// How many levels of nodes there are, the root alone is 1
+		uint32_t depth{ 1U };
+		// See SetElementMargin
+		float elementMargin{ 0.0f };
 	};
 
 	// Non-copyable quadtree designed to host static elements
@@ -340,14 +1304,15 @@ namespace adm
 	//using Quadtree = NTree<elementType, Rect, 2>;
 
 	// Non-copyable octree designed to host static elements
-	template<typename elementType>
-	using Octree = NTree<elementType, AABB, 3>;
+	template<typename elementType, typename Policy = NTreeFunctionPolicy<elementType, AABB, 3>>
+	using Octree = NTree<elementType, AABB, 3, Policy>;
 
 	// In this namespace are utility functions when you construct one of the
 	// more specific tree classes, like Octree
 	// Example: Octree( bbox, IntersectsAABB, OccupiesBox, SimpleThreshold<Vec3, 100>, GetAABBForChild );
 	// It gets a little wordy, but at least it's pretty modular and you can implement your own functions
 	// for subdivision, intersection etc.
+	// They can also be passed to OctreeStaticPolicy, so that they get inlined
 	namespace utils
 	{
 		// For Octree::intersectsVolume
@@ -369,6 +1334,57 @@ namespace adm
 			return 1.0f;
 		}
 
+		// For Octree::QuerySphere
+		inline bool PointInSphere( const Vec3& point, const Vec3& centre, float radius )
+		{
+			return (point - centre).LengthSquared() <= radius * radius;
+		}
+
+		// For Octree::QueryFrustum
+		inline bool PointInPlanes( const Vec3& point, const Plane* planes, size_t numPlanes )
+		{
+			for ( size_t i = 0U; i < numPlanes; i++ )
+			{
+				if ( planes[i].EvalAtPoint( point ) < 0.0f )
+				{
+					return false;
+				}
+			}
+
+			return true;
+		}
+
+		// For Octree::RayCast, points are hit as if they were spheres of this radius
+		struct PointRayTest
+		{
+			float radius{ 1.0f };
+
+			bool operator()( const Vec3& point, const Vec3& start, const Vec3& end, float& outFraction ) const
+			{
+				const Vec3 direction = end - start;
+				const Vec3 toStart = start - point;
+				const float a = direction * direction;
+				const float b = toStart * direction;
+				const float c = toStart * toStart - radius * radius;
+
+				// Starting inside the sphere counts as hitting it right away
+				if ( c <= 0.0f )
+				{
+					outFraction = 0.0f;
+					return true;
+				}
+
+				const float discriminant = b * b - a * c;
+				if ( a <= 0.0f || b > 0.0f || discriminant < 0.0f )
+				{
+					return false;
+				}
+
+				outFraction = (-b - std::sqrt( discriminant )) / a;
+				return outFraction <= 1.0f;
+			}
+		};
+
 		// For Octree::getSubdividedBoundingVolumeForChild
 		inline AABB GetAABBForChild( AABB parentBbox, size_t i )
 		{
@@ -405,4 +1421,9 @@ namespace adm
 			return AABB( centre, extent );
 		}
 	}
+
+	// Octree policy with functions known at compile time, e.g. the ones from utils
+	// Example: Octree<Vec3, OctreeStaticPolicy<Vec3, utils::IntersectsAABB, utils::SimpleThreshold<Vec3, 16>>> octree( bbox );
+	template<typename elementType, auto intersectsBox, auto shouldSubdivide, auto occupiesBox = nullptr>
+	using OctreeStaticPolicy = NTreeStaticPolicy<elementType, AABB, 3, intersectsBox, shouldSubdivide, utils::GetAABBForChild, occupiesBox>;
 }
@@ -0,0 +1,153 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+namespace adm
+{
+	// ============================
+	// StableVector
+	//
+	// A dynamic array whose elements never move, so pointers
+	// and references to them stay valid as more are added,
+	// and when the array itself is moved
+	// Elements go into chunks, each twice as big as the last,
+	// the first one holding FirstChunkSize of them, which is
+	// only allocated once something is added
+	// ============================
+	template<class T, size_t FirstChunkSize = 8U>
+	class StableVector final
+	{
+		static_assert( FirstChunkSize > 0U && (FirstChunkSize & (FirstChunkSize - 1U)) == 0U,
+			"FirstChunkSize must be a power of two" );
+
+	public:
+		StableVector() = default;
+
+		StableVector( const StableVector& other )
+		{
+			for ( size_t i = 0U; i < other.count; i++ )
+			{
+				emplace_back( other[i] );
+			}
+		}
+
+		StableVector( StableVector&& other ) noexcept
+			: chunks( std::move( other.chunks ) ), count( other.count )
+		{
+			other.chunks.clear();
+			other.count = 0U;
+		}
+
+		~StableVector()
+		{
+			clear();
+		}
+
+		StableVector& operator=( const StableVector& other )
+		{
+			if ( this != &other )
+			{
+				StableVector copy( other );
+				std::swap( chunks, copy.chunks );
+				std::swap( count, copy.count );
+			}
+
+			return *this;
+		}
+
+		StableVector& operator=( StableVector&& other ) noexcept
+		{
+			if ( this != &other )
+			{
+				clear();
+				chunks = std::move( other.chunks );
+				count = other.count;
+				other.chunks.clear();
+				other.count = 0U;
+			}
+
+			return *this;
+		}
+
+		size_t size() const
+		{
+			return count;
+		}
+
+		bool empty() const
+		{
+			return count == 0U;
+		}
+
+		T& operator[]( size_t index )
+		{
+			return *At( index );
+		}
+
+		const T& operator[]( size_t index ) const
+		{
+			return *const_cast<StableVector*>( this )->At( index );
+		}
+
+		T& back()
+		{
+			return *At( count - 1U );
+		}
+
+		template<class... TArgs>
+		T& emplace_back( TArgs&&... args )
+		{
+			const size_t chunk = ChunkOf( count );
+			if ( chunk == chunks.size() )
+			{
+				chunks.emplace_back( new Storage[FirstChunkSize << chunk] );
+			}
+
+			T* element = new ( At( count ) ) T( std::forward<TArgs>( args )... );
+			count++;
+			return *element;
+		}
+
+		// Destroys the elements and frees the chunks
+		void clear()
+		{
+			for ( size_t i = 0U; i < count; i++ )
+			{
+				At( i )->~T();
+			}
+
+			chunks.clear();
+			count = 0U;
+		}
+
+	private:
+		struct Storage
+		{
+			alignas( T ) unsigned char bytes[sizeof( T )];
+		};
+
+		// Chunk n starts at FirstChunkSize * (2^n - 1)
+		static size_t ChunkOf( size_t index )
+		{
+			const uint64_t biased = index / FirstChunkSize + 1U;
+#if defined( _MSC_VER )
+			unsigned long highestBit;
+			_BitScanReverse64( &highestBit, biased );
+			return highestBit;
+#else
+			return 63U - __builtin_clzll( biased );
+#endif
+		}
+
+		T* At( size_t index )
+		{
+			const size_t chunk = ChunkOf( index );
+			const size_t offset = index - FirstChunkSize * ((size_t( 1U ) << chunk) - 1U);
+			return std::launder( reinterpret_cast<T*>( chunks[chunk][offset].bytes ) );
+		}
+
+		Vector<UniquePtr<Storage[]>> chunks;
+		size_t count{ 0 };
+	};
+}
@@ -63,6 +63,19 @@ namespace adm
 				&& point.x <= maxs.x && point.y <= maxs.y && point.z <= maxs.z;
 		}
 
+		// Checks if the two boxes overlap, touching counts
+		inline bool Intersects( const AABB& bbox ) const
+		{
+			return bbox.mins.x <= maxs.x && bbox.mins.y <= maxs.y && bbox.mins.z <= maxs.z
+				&& bbox.maxs.x >= mins.x && bbox.maxs.y >= mins.y && bbox.maxs.z >= mins.z;
+		}
+
+		// Checks if the other box is completely inside this one
+		inline bool Contains( const AABB& bbox ) const
+		{
+			return IsInside( bbox.mins ) && IsInside( bbox.maxs );
+		}
+
 		// Length of the 3D diagonal from mins to maxs
 		inline float Diagonal() const
 		{
@@ -34,7 +34,8 @@ namespace adm
 		__m128 t = _mm_mul_ps( columns[0].simdValue, _mm_shuffle_ps( v4.simdValue, v4.simdValue, _MM_SHUFFLE( 0, 0, 0, 0 ) ) );
 		t = _mm_add_ps( t, _mm_mul_ps( columns[1].simdValue, _mm_shuffle_ps( v4.simdValue, v4.simdValue, _MM_SHUFFLE( 1, 1, 1, 1 ) ) ) );
 		t = _mm_add_ps( t, _mm_mul_ps( columns[2].simdValue, _mm_shuffle_ps( v4.simdValue, v4.simdValue, _MM_SHUFFLE( 2, 2, 2, 2 ) ) ) );
-		return Vec3( Vec4( t ) );
+		const Vec4 result( t );
+		return Vec3( result.m.x, result.m.y, result.m.z );
 #else
 		return Vec3(
 			columns[0][0] * v[0] + columns[1][0] * v[1] + columns[2][0] * v[2],
@@ -55,7 +56,8 @@ namespace adm
 		const __m128 xy = _mm_blend_ps( x, y, 0b0010 );
 		const __m128 z = _mm_dp_ps( columns[2].simdValue, v4.simdValue, 0x7f );
 		const __m128 xyzz = _mm_blend_ps( xy, z, 0b1100 );
-		return xyzz;
+		const Vec4 result( xyzz );
+		return Vec3( result.m.x, result.m.y, result.m.z );
 #else
 		return Transposed3().Mul3( v );
 #endif
@@ -307,7 +309,8 @@ namespace adm
 		t = _mm_add_ps( t, _mm_mul_ps( columns[1].simdValue, _mm_shuffle_ps( v4.simdValue, v4.simdValue, _MM_SHUFFLE( 1, 1, 1, 1 ) ) ) );
 		t = _mm_add_ps( t, _mm_mul_ps( columns[2].simdValue, _mm_shuffle_ps( v4.simdValue, v4.simdValue, _MM_SHUFFLE( 2, 2, 2, 2 ) ) ) );
 		t = _mm_add_ps( t, columns[3].simdValue );
-		return Vec3( Vec4( t ) );
+		const Vec4 result( t );
+		return Vec3( result.m.x, result.m.y, result.m.z );
 #else
 		return Vec3(
 			columns[0][0] * rhs[0] + columns[1][0] * rhs[1] + columns[2][0] * rhs[2] + columns[3][0],
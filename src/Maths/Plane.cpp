@@ -8,3 +8,47 @@ const Plane Plane::Zero		= Plane( 0.0f, 0.0f, 0.0f, 0.0f );
 const Plane Plane::Forward	= Plane( Vec3::Forward, 0.0f );
 const Plane Plane::Right	= Plane( Vec3::Right, 0.0f );
 const Plane Plane::Up		= Plane( Vec3::Up, 0.0f );
+
+// ============================
+// Plane::FrustumFromViewProjection
+// 
+// A point is inside when -w <= x <= w, -w <= y <= w and
+// 0 <= z <= w in clip space, and each of those is a plane
+// made out of the matrix's columns (Gribb & Hartmann), as
+// points are multiplied from the left, like in Mat4::View
+// ============================
+Array<Plane, 6> Plane::FrustumFromViewProjection( const Mat4& viewProjection )
+{
+	const auto column = [&]( uint32_t index )
+	{
+		return Plane( viewProjection( 0, index ), viewProjection( 1, index ), viewProjection( 2, index ), viewProjection( 3, index ) );
+	};
+
+	const auto add = []( const Plane& lhs, const Plane& rhs, float sign )
+	{
+		return Plane( lhs.a + rhs.a * sign, lhs.b + rhs.b * sign, lhs.c + rhs.c * sign, lhs.d + rhs.d * sign );
+	};
+
+	const Plane w = column( 3 );
+	Array<Plane, 6> planes
+	{
+		add( w, column( 0 ), 1.0f ),
+		add( w, column( 0 ), -1.0f ),
+		add( w, column( 1 ), 1.0f ),
+		add( w, column( 1 ), -1.0f ),
+		column( 2 ),
+		add( w, column( 2 ), -1.0f )
+	};
+
+	// Normalise them, so that they give actual distances
+	for ( Plane& plane : planes )
+	{
+		const float length = plane.GetNormal().Length();
+		if ( length > 0.0f )
+		{
+			plane *= 1.0f / length;
+		}
+	}
+
+	return planes;
+}
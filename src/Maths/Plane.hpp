@@ -142,6 +142,12 @@ namespace adm
 			return std::make_pair( true, start + direction * u );
 		}
 
+		// Extracts the 6 planes of a view frustum, with normals pointing into it,
+		// from Mat4::View( ... ) * Mat4::Perspective( ... ) or Orthographic, which
+		// are applied as point * matrix, with depth going from 0 at the near plane to 1 at the far one
+		// Order: left, right, bottom, top, near, far
+		static Array<Plane, 6> FrustumFromViewProjection( const Mat4& viewProjection );
+
 	public: // Constants
 		static const Plane Zero;
 
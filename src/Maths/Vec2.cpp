@@ -33,17 +33,7 @@ Vec2::Vec2( const char* string )
 		return;
 	}
 
-	Lexer lex( string );
-	if ( lex.IsEndOfFile() )
-	{
-		return;
-	}
-
-	x = std::stof( lex.Next() );
-	if ( !lex.IsEndOfFile() )
-	{
-		y = std::stof( lex.Next() );
-	}
+	ParseFloats( string, &x, 2U );
 }
 
 const Vec2 Vec2::Identity 	= Vec2( 1.0f );
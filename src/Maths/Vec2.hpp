@@ -246,10 +246,8 @@ namespace std
 	// Extending le standard bibliotheque to support Vec2
 	inline std::string to_string( adm::Vec2 val )
 	{
-		// TODO: use fmtlib, sprintf is like 20x slower
-		char buffer[128]; // God forbid you put such a large number to overflow this...
-		snprintf( buffer, 128, "%f %f", val.x, val.y );
-		return std::string( buffer );
+		char buffer[adm::Vec2TextSize];
+		return std::string( buffer, adm::WriteFloats( &val.x, 2U, buffer, sizeof( buffer ) ) );
 	}
 
 	inline adm::Vec2 fabs( const adm::Vec2& v )
@@ -13,15 +13,6 @@ constexpr Vec3::Vec3( const Vec2& v, float Z )
 
 }
 
-// ============================
-// Vec3::ctor adapter for Vec4
-// ============================
-constexpr Vec3::Vec3( const Vec4& v )
-	: x( v.m.x ), y( v.m.y ), z( v.m.z )
-{
-
-}
-
 // ============================
 // Vec3::ctor for C strings
 // ============================
@@ -33,21 +24,7 @@ Vec3::Vec3( const char* string )
 		return;
 	}
 
-	Lexer lex( string );
-	if ( lex.IsEndOfFile() )
-	{
-		return;
-	}
-	
-	x = std::stof( lex.Next() );
-	if ( !lex.IsEndOfFile() )
-	{
-		y = std::stof( lex.Next() );
-	}
-	if ( !lex.IsEndOfFile() )
-	{
-		z = std::stof( lex.Next() );
-	}
+	ParseFloats( string, &x, 3U );
 }
 
 const Vec3 Vec3::Identity 	= Vec3( 1.0f );
@@ -260,10 +260,8 @@ namespace std
 	// Extending le standard bibliotheque to support Vec3
 	inline std::string to_string( adm::Vec3 val )
 	{
-		// TODO: use fmtlib, sprintf is like 20x slower
-		char buffer[128]; // God forbid you put such a large number to overflow this...
-		snprintf( buffer, 128, "%f %f %f", val.x, val.y, val.z );
-		return std::string( buffer );
+		char buffer[adm::Vec3TextSize];
+		return std::string( buffer, adm::WriteFloats( &val.x, 3U, buffer, sizeof( buffer ) ) );
 	}
 
 	inline adm::Vec3 fabs( const adm::Vec3& v )
@@ -15,25 +15,7 @@ Vec4::Vec4( const char* string )
 		return;
 	}
 
-	Lexer lex( string );
-	if ( lex.IsEndOfFile() )
-	{
-		return;
-	}
-	
-	m.x = std::stof( lex.Next() );
-	if ( !lex.IsEndOfFile() )
-	{
-		m.y = std::stof( lex.Next() );
-	}
-	if ( !lex.IsEndOfFile() )
-	{
-		m.z = std::stof( lex.Next() );
-	}
-	if ( !lex.IsEndOfFile() )
-	{
-		m.w = std::stof( lex.Next() );
-	}
+	ParseFloats( string, &m.x, 4U );
 }
 
 const Vec4 Vec4::Identity 	= Vec4( 1.0f );
@@ -301,6 +301,16 @@ namespace adm
 		};
 		
 	};
+
+	// ============================
+	// Vec3::ctor adapter for Vec4
+	// Defined here since it needs the complete Vec4
+	// ============================
+	constexpr Vec3::Vec3( const Vec4& v )
+		: x( v.m.x ), y( v.m.y ), z( v.m.z )
+	{
+
+	}
 }
 
 namespace std
@@ -308,10 +318,8 @@ namespace std
 	// Extending le standard bibliotheque to support Vec4
 	inline std::string to_string( adm::Vec4 val )
 	{
-		// TODO: use fmtlib, sprintf is like 20x slower
-		char buffer[128]; // God forbid you put such a large number to overflow this...
-		snprintf( buffer, 128, "%f %f %f %f", val.m.x, val.m.y, val.m.z, val.m.w );
-		return std::string( buffer );
+		char buffer[adm::Vec4TextSize];
+		return std::string( buffer, adm::WriteFloats( &val.m.x, 4U, buffer, sizeof( buffer ) ) );
 	}
 
 	inline adm::Vec4 fabs( const adm::Vec4& v )
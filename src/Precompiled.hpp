@@ -11,12 +11,17 @@
 #include <unordered_map>
 #include <vector>
 #include <list>
+#include <deque>
 // Strings
 #include <string>
 #include <string_view>
 #include <sstream>
+#include <charconv>
+#include <cctype>
 // Maths
 #include <cmath>
+#include <cfloat>
+#include <climits>
 #include <algorithm>
 // File system
 #include <fstream>
@@ -26,6 +31,10 @@
 #include <type_traits>
 #include <stdarg.h>
 #include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
 #include <functional>
 #include <memory>
 
@@ -49,10 +58,21 @@ namespace adm
 	template<class T>
 	using Vector = std::vector<T>;
 
+	// Open-addressing hash map, see Containers/FlatMap.hpp
+	template<class TKey, class TValue>
+	class FlatMap;
+
 	// This is actually an unordered map, but I've never 
 	// really needed to use std::map
+	// ADMUTIL_USE_FLAT_MAP swaps it for a FlatMap, which
+	// doesn't keep pointers to its entries stable though
+#if ADM_USE_FLAT_MAP
+	template<class TIndex, class TValue>
+	using Map = FlatMap<TIndex, TValue>;
+#else
 	template<class TIndex, class TValue>
 	using Map = std::unordered_map<TIndex, TValue>;
+#endif
 
 	template<class T>
 	using Optional = std::optional<T>;
@@ -88,6 +108,8 @@ namespace adm
 
 // Text processing
 #include "Text/Format.hpp" // Variadic adm::format
+#include "Text/Number.hpp" // Float/integer conversions into caller buffers
+#include "Text/SymbolTable.hpp" // String interning
 #include "Text/Lexer.hpp" // Text parsing
 #include "Text/JSON.hpp" // JSON parsing, really just a wrapper around nlohmann_json
 
@@ -101,11 +123,18 @@ namespace adm
 #include "Maths/Polygon.hpp"
 #include "Maths/AABB.hpp"
 
+// Needed by the containers below
+#include "System/TaskPool.hpp" // Work-stealing task pool
+
 // Containers and utilities
+#include "Containers/FlatMap.hpp" // Open-addressing hash map
+#include "Containers/StableVector.hpp" // Dynamic array that never moves its elements
 #include "Containers/NTree.hpp" // N-dimensional tree, quadtree, octree
 #include "Containers/Singleton.hpp" // Singleton wrapper
 #include "Containers/Chain.hpp" // Class-wide static linked list
 #include "Containers/Dictionary.hpp" // Dictionary/KV pairs
+#include "Containers/DictionaryArchive.hpp" // Binary, memory-mappable dictionary arrays
+#include "Containers/ConcurrentDictionary.hpp" // Dictionary with lock-free readers
 
 // Time utilities
 #include "Time/Timer.hpp" // Scope-based timer
@@ -113,3 +142,4 @@ namespace adm
 
 // System-interfacing stuff
 #include "System/Library.hpp"
+#include "System/MappedFile.hpp" // Read-only memory-mapped files
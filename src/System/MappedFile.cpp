@@ -0,0 +1,159 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#include "Precompiled.hpp"
+using namespace adm;
+
+#if ADM_PLATFORM == PLATFORM_WINDOWS
+#include <Windows.h>
+#elif ADM_PLATFORM == PLATFORM_LINUX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Empty files cannot be mapped, so they get to point here
+static const char EmptyFileData[1]{};
+
+static bool SystemMapFile( const char* path, bool sequential, const char*& outData, size_t& outSize )
+{
+#if ADM_PLATFORM == PLATFORM_WINDOWS
+
+	const DWORD flags = sequential ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_ATTRIBUTE_NORMAL;
+	HANDLE file = CreateFileA( path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, flags, nullptr );
+	if ( file == INVALID_HANDLE_VALUE )
+	{
+		return false;
+	}
+
+	LARGE_INTEGER fileSize{};
+	if ( !GetFileSizeEx( file, &fileSize ) )
+	{
+		CloseHandle( file );
+		return false;
+	}
+
+	if ( fileSize.QuadPart == 0 )
+	{
+		CloseHandle( file );
+		outData = EmptyFileData;
+		outSize = 0;
+		return true;
+	}
+
+	// The view keeps the file mapping alive, so the handles can be closed right away
+	HANDLE mapping = CreateFileMappingA( file, nullptr, PAGE_READONLY, 0, 0, nullptr );
+	CloseHandle( file );
+	if ( nullptr == mapping )
+	{
+		return false;
+	}
+
+	void* view = MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+	CloseHandle( mapping );
+	if ( nullptr == view )
+	{
+		return false;
+	}
+
+	outData = static_cast<const char*>(view);
+	outSize = size_t( fileSize.QuadPart );
+	return true;
+
+#elif ADM_PLATFORM == PLATFORM_LINUX
+
+	const int file = open( path, O_RDONLY | O_CLOEXEC );
+	if ( file < 0 )
+	{
+		return false;
+	}
+
+	struct stat fileStat{};
+	if ( fstat( file, &fileStat ) != 0 )
+	{
+		close( file );
+		return false;
+	}
+
+	if ( fileStat.st_size == 0 )
+	{
+		close( file );
+		outData = EmptyFileData;
+		outSize = 0;
+		return true;
+	}
+
+	// The mapping stays valid after the descriptor is closed
+	void* view = mmap( nullptr, size_t( fileStat.st_size ), PROT_READ, MAP_PRIVATE, file, 0 );
+	close( file );
+	if ( view == MAP_FAILED )
+	{
+		return false;
+	}
+
+	if ( sequential )
+	{
+		madvise( view, size_t( fileStat.st_size ), MADV_SEQUENTIAL );
+	}
+
+	outData = static_cast<const char*>(view);
+	outSize = size_t( fileStat.st_size );
+	return true;
+
+#endif
+}
+
+static void SystemUnmapFile( const char* data, size_t size )
+{
+	if ( nullptr == data || data == EmptyFileData )
+	{
+		return;
+	}
+
+#if ADM_PLATFORM == PLATFORM_WINDOWS
+
+	UnmapViewOfFile( data );
+
+#elif ADM_PLATFORM == PLATFORM_LINUX
+
+	munmap( const_cast<char*>(data), size );
+
+#endif
+}
+
+adm::MappedFile::MappedFile( StringView filePath, bool sequential )
+{
+	const String path( filePath );
+	isOpen = SystemMapFile( path.c_str(), sequential, data, size );
+}
+
+adm::MappedFile::MappedFile( MappedFile&& file ) noexcept
+{
+	data = file.data;
+	size = file.size;
+	isOpen = file.isOpen;
+
+	file.data = nullptr;
+	file.size = 0;
+	file.isOpen = false;
+}
+
+adm::MappedFile::~MappedFile()
+{
+	Dispose();
+}
+
+void adm::MappedFile::Dispose()
+{
+	SystemUnmapFile( data, size );
+
+	data = nullptr;
+	size = 0;
+	isOpen = false;
+}
+
+adm::MappedFile::operator bool() const
+{
+	return isOpen;
+}
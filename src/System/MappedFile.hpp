@@ -0,0 +1,54 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+namespace adm
+{
+	// ============================
+	// MappedFile
+	//
+	// A read-only memory-mapped file
+	// Usage:
+	// 
+	// MappedFile file( "maps/test.map" );
+	// if ( file )
+	//     DoSomething( file.GetView() );
+	// ============================
+	class MappedFile final
+	{
+	public:
+		MappedFile() = default;
+		// @param sequential: hints the OS that the file will be read front to back
+		MappedFile( StringView filePath, bool sequential = false );
+		MappedFile( MappedFile&& file ) noexcept;
+		MappedFile( const MappedFile& file ) = delete;
+		~MappedFile();
+
+		// Unmaps the file
+		void Dispose();
+
+		const char* GetData() const
+		{
+			return data;
+		}
+
+		size_t GetSize() const
+		{
+			return size;
+		}
+
+		StringView GetView() const
+		{
+			return StringView( data, size );
+		}
+
+		// @returns Whether the file was opened, an empty file counts too
+		operator bool() const;
+
+	private:
+		const char* data{ nullptr };
+		size_t size{ 0 };
+		bool isOpen{ false };
+	};
+}
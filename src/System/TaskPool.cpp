@@ -0,0 +1,187 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#include "Precompiled.hpp"
+using namespace adm;
+
+// Every worker has its own queue, so they only fight over it while stealing
+struct alignas( 64 ) TaskPool::Worker
+{
+	std::mutex mutex;
+	std::deque<Task> tasks;
+};
+
+// ============================
+// TaskPool::ctor
+// ============================
+TaskPool::TaskPool( size_t numThreads )
+{
+	if ( numThreads == 0U )
+	{
+		numThreads = std::max( std::thread::hardware_concurrency(), 1U );
+	}
+
+	workers.reserve( numThreads );
+	for ( size_t i = 0U; i < numThreads; i++ )
+	{
+		workers.push_back( std::make_unique<Worker>() );
+	}
+
+	// Worker 0 is whoever calls Run
+	threads.reserve( numThreads - 1U );
+	for ( size_t i = 1U; i < numThreads; i++ )
+	{
+		threads.emplace_back( [this, i]() { WorkLoop( i ); } );
+	}
+}
+
+// ============================
+// TaskPool::dtor
+// ============================
+TaskPool::~TaskPool()
+{
+	{
+		std::lock_guard<std::mutex> lock( sleepMutex );
+		stopping = true;
+	}
+	wakeUp.notify_all();
+
+	for ( std::thread& thread : threads )
+	{
+		thread.join();
+	}
+}
+
+// ============================
+// TaskPool::Run
+// ============================
+void TaskPool::Run( Task task )
+{
+	Spawn( 0U, std::move( task ) );
+	WorkLoop( 0U );
+
+	// Every task is done, so nobody else touches it anymore
+	if ( nullptr != exception )
+	{
+		std::exception_ptr thrown = std::move( exception );
+		exception = nullptr;
+		std::rethrow_exception( thrown );
+	}
+}
+
+// ============================
+// TaskPool::Spawn
+// ============================
+void TaskPool::Spawn( size_t workerIndex, Task task )
+{
+	// Counted before it's queued, so the pool can't run
+	// out of pending tasks while the spawner is still busy
+	numPending.fetch_add( 1U );
+
+	{
+		Worker& worker = *workers[workerIndex];
+		std::lock_guard<std::mutex> lock( worker.mutex );
+		worker.tasks.push_back( std::move( task ) );
+	}
+
+	// Counted with the lock held, so a worker that is about
+	// to fall asleep either sees it or gets woken up for it
+	{
+		std::lock_guard<std::mutex> lock( sleepMutex );
+		numQueued.fetch_add( 1U );
+	}
+	wakeUp.notify_one();
+}
+
+// ============================
+// TaskPool::TakeTask
+// ============================
+bool TaskPool::TakeTask( size_t workerIndex, Task& outTask )
+{
+	// Own tasks first, the newest one is the most likely to be in cache
+	{
+		Worker& worker = *workers[workerIndex];
+		std::lock_guard<std::mutex> lock( worker.mutex );
+		if ( !worker.tasks.empty() )
+		{
+			outTask = std::move( worker.tasks.back() );
+			worker.tasks.pop_back();
+			numQueued.fetch_sub( 1U );
+			return true;
+		}
+	}
+
+	// Then the oldest ones of the other workers
+	for ( size_t i = 1U; i < workers.size(); i++ )
+	{
+		Worker& victim = *workers[(workerIndex + i) % workers.size()];
+		std::lock_guard<std::mutex> lock( victim.mutex );
+		if ( !victim.tasks.empty() )
+		{
+			outTask = std::move( victim.tasks.front() );
+			victim.tasks.pop_front();
+			numQueued.fetch_sub( 1U );
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// ============================
+// TaskPool::RunTask
+// 
+// A task that throws still counts as done, otherwise
+// the others would wait for it forever
+// ============================
+void TaskPool::RunTask( size_t workerIndex, Task& task )
+{
+	try
+	{
+		task( workerIndex );
+	}
+	catch ( ... )
+	{
+		std::lock_guard<std::mutex> lock( sleepMutex );
+		if ( nullptr == exception )
+		{
+			exception = std::current_exception();
+		}
+	}
+
+	task = nullptr;
+	if ( numPending.fetch_sub( 1U ) == 1U )
+	{
+		// The last one, Run may be waiting for it
+		std::lock_guard<std::mutex> lock( sleepMutex );
+		wakeUp.notify_all();
+	}
+}
+
+// ============================
+// TaskPool::WorkLoop
+// ============================
+void TaskPool::WorkLoop( size_t workerIndex )
+{
+	const auto isDone = [this, workerIndex]()
+	{
+		return workerIndex == 0U ? numPending.load() == 0U : stopping;
+	};
+
+	Task task;
+	while ( true )
+	{
+		if ( TakeTask( workerIndex, task ) )
+		{
+			RunTask( workerIndex, task );
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock( sleepMutex );
+		wakeUp.wait( lock, [&]() { return numQueued.load() > 0U || isDone(); } );
+		if ( isDone() )
+		{
+			return;
+		}
+	}
+}
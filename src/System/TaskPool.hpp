@@ -0,0 +1,74 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+namespace adm
+{
+	// ============================
+	// TaskPool
+	//
+	// A work-stealing pool for recursive jobs, like building a tree
+	// Usage:
+	//
+	// TaskPool pool( 0 );
+	// pool.Run( [&]( size_t worker ) { Build( pool, worker, root ); } );
+	//
+	// ...where Build calls pool.Spawn( worker, ... ) for every
+	// subtree that's big enough to be worth handing off
+	// Each worker takes its newest task first and steals the
+	// oldest ones from the others, those tend to be the biggest
+	//
+	// The threads are started once and sleep between runs, so
+	// keep the pool around if it's going to be used often
+	// ============================
+	class TaskPool final
+	{
+	public:
+		// @param workerIndex: which worker runs the task, from 0 to GetNumThreads() - 1
+		using Task = std::function<void( size_t workerIndex )>;
+
+		// @param numThreads: 0 means one per hardware thread, the calling thread included
+		explicit TaskPool( size_t numThreads = 0U );
+		TaskPool( const TaskPool& pool ) = delete;
+		// No run may be going on by now
+		~TaskPool();
+
+		size_t GetNumThreads() const
+		{
+			return workers.size();
+		}
+
+		// Runs the task on the calling thread as worker 0, while the other
+		// workers pick up what it spawns, returns once every task is done
+		// If tasks throw, the rest still finish, then the first exception is rethrown here
+		// Only one thread may be running the pool at a time
+		void Run( Task task );
+
+		// Queues a task, only to be called from inside a task
+		// @param workerIndex: the worker that is spawning it
+		void Spawn( size_t workerIndex, Task task );
+
+	private:
+		struct Worker;
+
+		// @returns False if there was nothing to take or steal
+		bool		TakeTask( size_t workerIndex, Task& outTask );
+		void		RunTask( size_t workerIndex, Task& task );
+		// Worker 0 leaves once the run is done, the others when the pool is destroyed
+		void		WorkLoop( size_t workerIndex );
+
+		Vector<UniquePtr<Worker>> workers;
+		Vector<std::thread> threads;
+		// Tasks that were queued but haven't finished yet
+		std::atomic<size_t> numPending{ 0U };
+		// Tasks that are waiting in a queue, only goes up with sleepMutex held
+		std::atomic<size_t> numQueued{ 0U };
+
+		// Idle workers wait here for tasks, and Run for the last one to finish
+		std::mutex	sleepMutex;
+		std::condition_variable wakeUp;
+		bool		stopping{ false };
+		std::exception_ptr exception;
+	};
+}
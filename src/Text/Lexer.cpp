@@ -4,6 +4,78 @@
 #include "Precompiled.hpp"
 using namespace adm;
 
+#if ADM_PLATFORM == PLATFORM_WINDOWS
+#include <io.h>
+#elif ADM_PLATFORM == PLATFORM_LINUX
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+#if ADM_USE_SSE41
+// Index of the lowest set bit, the mask must not be 0
+static inline uint32_t LowestBitIndex( uint32_t mask )
+{
+#if defined( _MSC_VER )
+	unsigned long index;
+	_BitScanForward( &index, mask );
+	return index;
+#else
+	return __builtin_ctz( mask );
+#endif
+}
+
+// 16 bytes at a time, gives a bitmask of the bytes that equal c
+static inline uint32_t MatchBytes( __m128i chunk, char c )
+{
+	return _mm_movemask_epi8( _mm_cmpeq_epi8( chunk, _mm_set1_epi8( c ) ) );
+}
+#endif
+
+// Finds the first a or b in [from, to), or "to" if there's none
+static size_t FindEither( const char* data, size_t from, size_t to, char a, char b )
+{
+#if ADM_USE_SSE41
+	while ( from + 16U <= to )
+	{
+		const __m128i chunk = _mm_loadu_si128( reinterpret_cast<const __m128i*>(data + from) );
+		const uint32_t mask = MatchBytes( chunk, a ) | MatchBytes( chunk, b );
+		if ( mask )
+		{
+			return from + LowestBitIndex( mask );
+		}
+
+		from += 16U;
+	}
+#endif
+
+	while ( from < to && data[from] != a && data[from] != b )
+	{
+		from++;
+	}
+
+	return from;
+}
+
+// Runs work( 0 ) to work( count - 1 ) on separate threads,
+// the first one on the calling thread, and waits for all of them
+template<typename Function>
+static void RunParallel( size_t count, const Function& work )
+{
+	Vector<std::thread> threads;
+	threads.reserve( count );
+	for ( size_t i = 1U; i < count; i++ )
+	{
+		threads.emplace_back( [&work, i]() { work( i ); } );
+	}
+
+	work( 0U );
+
+	for ( std::thread& thread : threads )
+	{
+		thread.join();
+	}
+}
+
 // ============================
 // Lexer::ctor
 // ============================
@@ -19,10 +91,41 @@ Lexer::Lexer( Lexer&& other ) noexcept
 {
 	position = other.position;
 	inQuote = other.inQuote;
+	scanRestart = other.scanRestart;
+	quoteOffset = other.quoteOffset;
+	quoteSearched = other.quoteSearched;
+	lineCursor = other.lineCursor;
+	lineNumber = other.lineNumber;
+	lineStart = other.lineStart;
 
-	buffer = std::move( other.buffer );
+	reader = std::move( other.reader );
+	chunkSize = other.chunkSize;
+	windowOffset = other.windowOffset;
+	pinnedOffset = other.pinnedOffset;
+	readerFinished = other.readerFinished;
+
+	lookahead = other.lookahead;
+	lookaheadHead = other.lookaheadHead;
+	lookaheadCount = other.lookaheadCount;
+	lookaheadWithDelimiter = other.lookaheadWithDelimiter;
+	lookaheadLineNumber = other.lookaheadLineNumber;
+	lookaheadLineStart = other.lookaheadLineStart;
+
+	mappedFile = std::move( other.mappedFile );
+	if ( mappedFile )
+	{
+		view = other.view;
+	}
+	else
+	{
+		buffer = std::move( other.buffer );
+		view = buffer;
+	}
 	delimiterString = std::move( other.delimiterString );
-	view = buffer;
+	charClasses = other.charClasses;
+
+	symbolTable = std::move( other.symbolTable );
+	internStrings = other.internStrings;
 }
 
 // ============================
@@ -30,11 +133,40 @@ Lexer::Lexer( Lexer&& other ) noexcept
 // ============================
 Lexer::Lexer( const Lexer& other )
 {
+	// Mapped files are read-only, so they can be shared
+	if ( other.mappedFile )
+	{
+		mappedFile = other.mappedFile;
+		view = other.view;
+	}
+	else
+	{
+		Load( other.buffer );
+	}
+	delimiterString = other.delimiterString;
+	charClasses = other.charClasses;
+	symbolTable = other.symbolTable;
+	internStrings = other.internStrings;
+
 	position = other.position;
 	inQuote = other.inQuote;
+	scanRestart = other.scanRestart;
+	quoteOffset = other.quoteOffset;
+	quoteSearched = other.quoteSearched;
+	lineCursor = other.lineCursor;
+	lineNumber = other.lineNumber;
+	lineStart = other.lineStart;
 
-	Load( other.buffer );
-	delimiterString = other.delimiterString;
+	lookahead = other.lookahead;
+	lookaheadHead = other.lookaheadHead;
+	lookaheadCount = other.lookaheadCount;
+	lookaheadWithDelimiter = other.lookaheadWithDelimiter;
+	lookaheadLineNumber = other.lookaheadLineNumber;
+	lookaheadLineStart = other.lookaheadLineStart;
+
+	// A stream can't be read by two lexers at once, so
+	// a copy of a streaming lexer only gets its current window
+	windowOffset = other.windowOffset;
 }
 
 // ============================
@@ -42,19 +174,7 @@ Lexer::Lexer( const Lexer& other )
 // ============================
 Lexer::Lexer( std::fstream& fileStream )
 {
-	// There's currently not much of a clean way to do this,
-	// as far as I'm aware
-	// It'd be nice if I could just grab the sstream buffer directly
-	// and pass it as a const char* to Load
-	String line, text;
-	std::ostringstream sstream;
-	while ( std::getline( fileStream, line ) )
-	{
-		sstream << line.c_str() << '\n';
-	}
-
-	text = sstream.str();
-	Load( text );
+	LoadStream( fileStream );
 }
 
 // ============================
@@ -62,15 +182,7 @@ Lexer::Lexer( std::fstream& fileStream )
 // ============================
 Lexer::Lexer( std::ifstream& fileStream )
 {
-	String line, text;
-	std::ostringstream sstream;
-	while ( std::getline( fileStream, line ) )
-	{
-		sstream << line.c_str() << '\n';
-	}
-
-	text = sstream.str();
-	Load( text );
+	LoadStream( fileStream );
 }
 
 // ============================
@@ -97,15 +209,84 @@ Lexer::Lexer( StringView text )
 	Load( text );
 }
 
+// ============================
+// Lexer::FromFile
+// ============================
+Optional<Lexer> Lexer::FromFile( StringView filePath )
+{
+	auto file = std::make_shared<MappedFile>( filePath, true );
+	if ( !*file )
+	{
+		return {};
+	}
+
+	Lexer lexer;
+	lexer.SetDelimiters( DelimitersDefault );
+	lexer.view = file->GetView();
+	lexer.mappedFile = std::move( file );
+
+	return lexer;
+}
+
+// ============================
+// Lexer::FromStream
+// ============================
+Lexer Lexer::FromStream( std::istream& stream, size_t chunkSize )
+{
+	return FromReader( [&stream]( char* destination, size_t maxBytes )
+		{
+			stream.read( destination, std::streamsize( maxBytes ) );
+			return size_t( stream.gcount() );
+		}, chunkSize );
+}
+
+// ============================
+// Lexer::FromDescriptor
+// ============================
+Lexer Lexer::FromDescriptor( int fileDescriptor, size_t chunkSize )
+{
+	return FromReader( [fileDescriptor]( char* destination, size_t maxBytes )
+		{
+#if ADM_PLATFORM == PLATFORM_WINDOWS
+			const int bytesRead = _read( fileDescriptor, destination, unsigned( std::min<size_t>( maxBytes, INT_MAX ) ) );
+			return bytesRead > 0 ? size_t( bytesRead ) : 0U;
+#elif ADM_PLATFORM == PLATFORM_LINUX
+			ssize_t bytesRead;
+			do
+			{
+				bytesRead = read( fileDescriptor, destination, maxBytes );
+			} while ( bytesRead < 0 && errno == EINTR );
+
+			return bytesRead > 0 ? size_t( bytesRead ) : 0U;
+#endif
+		}, chunkSize );
+}
+
+// ============================
+// Lexer::FromReader
+// ============================
+Lexer Lexer::FromReader( std::function<ReadFn> reader, size_t chunkSize )
+{
+	Lexer lexer;
+	lexer.SetDelimiters( DelimitersDefault );
+	lexer.reader = std::move( reader );
+	lexer.chunkSize = std::max<size_t>( chunkSize, 16U );
+	lexer.Refill( 0 );
+
+	return lexer;
+}
+
 // ============================
 // Lexer::Clear
 // ============================
 void Lexer::Clear()
 {
-	position = 0;
+	ResetState();
 	
 	buffer.clear();
+	view = buffer;
 	delimiterString.clear();
+	charClasses = BuildCharClasses( "" );
 }
 
 // ============================
@@ -113,8 +294,7 @@ void Lexer::Clear()
 // ============================
 void Lexer::Load( const char* text )
 {
-	buffer = text;
-	view = buffer;
+	Load( StringView( text ) );
 }
 
 // ============================
@@ -122,7 +302,10 @@ void Lexer::Load( const char* text )
 // ============================
 void Lexer::Load( StringView text )
 {
-	Load( text.data() );
+	ResetState();
+
+	buffer = text;
+	view = buffer;
 }
 
 // ============================
@@ -135,7 +318,59 @@ void Lexer::SetDelimiters( const char* delimiters )
 		delimiters = "";
 	}
 
+	// Anything peeked so far was split up with the old delimiters
+	DiscardLookahead();
+
 	delimiterString = delimiters;
+	charClasses = BuildCharClasses( delimiterString.c_str() );
+}
+
+// ============================
+// Lexer::SetSymbolTable
+// ============================
+void Lexer::SetSymbolTable( SharedPtr<SymbolTable> table, bool internStrings )
+{
+	// Peeked tokens would be missing their symbols
+	DiscardLookahead();
+
+	symbolTable = std::move( table );
+	this->internStrings = internStrings;
+}
+
+// ============================
+// Lexer::GetSymbolTable
+// ============================
+const SharedPtr<SymbolTable>& Lexer::GetSymbolTable() const
+{
+	return symbolTable;
+}
+
+// ============================
+// Lexer::BuildCharClasses
+// 
+// Compiles the delimiters and other special
+// characters into a lookup table, so the
+// tokeniser can classify each character
+// with a single lookup
+// ============================
+Lexer::CharClassTable Lexer::BuildCharClasses( const char* delimiters )
+{
+	CharClassTable table{};
+
+	table[uint8_t( ' ' )] |= CharClasses::Whitespace;
+	table[uint8_t( '\t' )] |= CharClasses::Whitespace;
+	table[uint8_t( '\0' )] |= CharClasses::Whitespace;
+	table[uint8_t( '\n' )] |= CharClasses::NewLine;
+	table[uint8_t( '\r' )] |= CharClasses::NewLine;
+	table[uint8_t( '"' )] |= CharClasses::Quote;
+	table[uint8_t( '/' )] |= CharClasses::CommentStart;
+
+	for ( const char* c = delimiters; *c; c++ )
+	{
+		table[uint8_t( *c )] |= CharClasses::Delimiter;
+	}
+
+	return table;
 }
 
 // ============================
@@ -143,221 +378,1097 @@ void Lexer::SetDelimiters( const char* delimiters )
 // ============================
 String Lexer::Next( bool withDelimiter )
 {
-	if ( IsEndOfFile() )
+	TokenKinds::Type kind;
+	String result( NextView( withDelimiter, false, kind ) );
+
+	if ( GluesQuote( kind, position, inQuote ) )
 	{
-		return "";
+		result += NextView( withDelimiter, true, kind );
 	}
 
-	String result{};
+	return result;
+}
+
+// ============================
+// Lexer::GluesQuote
+// 
+// A quotation mark right after an ordinary token
+// doesn't end it, the quoted text is glued on
+// ============================
+bool Lexer::GluesQuote( TokenKinds::Type kind, size_t at, bool atInQuote ) const
+{
+	const bool ordinary = kind == TokenKinds::Identifier || kind == TokenKinds::Number;
+	return ordinary && !atInQuote && at < view.size() && (CharClassAt( at ) & CharClasses::Quote);
+}
 
-	// This do-while loop is responsible for skipping "empty" lines
-	// and advancing to the next ones, until we get a usable token
-	do
+// ============================
+// Lexer::Scan
+// 
+// Finds the next token and tells what kind it is
+// ============================
+StringView Lexer::Scan( bool withDelimiter, bool withEmptyQuotes, TokenKinds::Type& kind )
+{
+	StringView result = ScanWindow( withDelimiter, withEmptyQuotes, kind );
+
+	// When streaming, the window may have ended in the middle of
+	// a token, quote or comment, so get more text and go again
+	// from the last point where the scan was between tokens
+	while ( position >= view.size() && CanRefill() )
 	{
-		// Skip any whitespaces etc. after a token
-		while ( !CanAdvance() && !IsDelimiter() && !IsEndOfFile() )
-		{
-			if ( IsComment() )
-			{
-				NewLine();
-				continue;
-			}
+		position = scanRestart;
+		inQuote = false;
+		Refill( position );
+
+		result = ScanWindow( withDelimiter, withEmptyQuotes, kind );
+	}
+
+	return result;
+}
 
+// ============================
+// Lexer::ScanWindow
+// 
+// The tokeniser itself, works only
+// with what's currently in the buffer
+// ============================
+StringView Lexer::ScanWindow( bool withDelimiter, bool withEmptyQuotes, TokenKinds::Type& kind )
+{
+	const size_t size = view.size();
+	// Where the current token/comment/gap began, it is only written
+	// to scanRestart on the way out to keep the loop tight
+	size_t restart = position;
+
+	// This loop is responsible for skipping whitespaces, comments,
+	// "empty" lines and delimiters until we get a usable token
+	while ( position < size )
+	{
+		restart = position;
+		const uint8_t charClass = CharClassAt( position );
+
+		// Skip any whitespaces etc. before a token
+		if ( charClass & (CharClasses::Whitespace | CharClasses::NewLine) )
+		{
+			// Most gaps between tokens are a single character,
+			// only bother with a full scan for longer ones
 			position++;
-			if ( IsEndOfFile() )
+			if ( position < size && (CharClassAt( position ) & (CharClasses::Whitespace | CharClasses::NewLine)) )
 			{
-				return "";
+				position = SkipWhitespace( position + 1 );
 			}
+			continue;
 		}
 
-		// Can't go any further
-		if ( IsEndOfFile() )
+		// We only support single-line comments, so
+		// if a comment is encountered, skip the whole line
+		// This goes before delimiters, since '/' may be one
+		if ( charClass & CharClasses::CommentStart )
 		{
-			if constexpr ( DebugLexer )
+			if ( IsComment() )
+			{
+				NewLine();
+				continue;
+			}
+
+			// A '/' at the very end of the window could be the
+			// start of a comment, can't tell until there's more
+			if ( position + 1U == size && CanRefill() )
 			{
-				printf( "Lexer::Next: EOF\n" );
+				position = size;
+				scanRestart = restart;
+				kind = TokenKinds::EndOfFile;
+				return {};
 			}
-			return "";
 		}
 
 		// Check for delimiters
-		if ( IsDelimiter() )
+		if ( charClass & CharClasses::Delimiter )
 		{
 			if ( withDelimiter )
 			{
-				result = char( view[position] );
-				IncrementPosition();
+				const StringView result = view.substr( position, 1U );
+				position++;
+				kind = TokenKinds::Delimiter;
+				scanRestart = restart;
 				return result;
 			}
 
-			IncrementPosition();
+			position++;
 			continue;
 		}
 
-		while ( CanAdvance() )
+		// A quotation mark has been encountered while
+		// we weren't in quote mode - engage, and take
+		// everything until the ending quotation mark
+		if ( charClass & CharClasses::Quote )
 		{
-			// We only support single-line comments, so
-			// if a comment is encountered, skip the whole line
-			if ( IsComment() )
+			if constexpr ( DebugLexer )
 			{
-				NewLine();
-				continue;
+				printf( "Lexer::Scan: found a '\"', toggling quote mode\n" );
+			}
+
+			ToggleQuoteMode();
+			position++;
+
+			// If this quote was cut off by the end of the window
+			// before, the text searched back then has no quotation
+			// mark in it, so don't go through it again
+			const size_t start = position;
+			if ( quoteOffset == windowOffset + restart )
+			{
+				position = std::max( start, quoteSearched - windowOffset );
+			}
+			position = FindQuote( position );
+
+			if ( position >= size && CanRefill() )
+			{
+				quoteOffset = windowOffset + restart;
+				quoteSearched = windowOffset + size;
 			}
 
-			// A quotation mark has been encountered while
-			// we weren't in quote mode - engage
-			if ( view[position] == '"' )
+			const StringView result = view.substr( start, position - start );
+
+			// Escape from a quote
+			if ( position < size )
 			{
 				if constexpr ( DebugLexer )
 				{
-					printf( "Lexer::Next: found a '\"', toggling quote mode\n" );
+					printf( "Lexer::Scan: found a '\"', toggling quote mode\n" );
 				}
 
 				ToggleQuoteMode();
-				IncrementPosition();
+				position++;
+			}
+
+			// Empty quotes are not a usable token,
+			// unless the caller can tell them apart from EOF
+			if ( result.empty() && !withEmptyQuotes )
+			{
 				continue;
 			}
 
-			// In quote mode, we add spaces and tabs too
-			if ( CanAdd() )
+			if constexpr ( DebugLexer )
 			{
-				result += view[position];
+				printf( "Lexer::Scan: token '%.*s'\n", int( result.size() ), result.data() );
 			}
 
-			// Safely increment the position so we don't go out of bounds
-			IncrementPosition();
+			kind = TokenKinds::String;
+			scanRestart = restart;
+			return result;
 		}
-	} while ( result.empty() );
 
-	if constexpr ( DebugLexer )
-	{
-		printf( "Lexer::Next: token '%s'\n", result.c_str() );
-	}
+		// Ordinary token, it ends at a whitespace, delimiter,
+		// quotation mark or the start of a comment
+		const size_t start = position;
+		while ( ++position < size )
+		{
+			const uint8_t nextClass = CharClassAt( position );
+			if ( !(nextClass & CharClasses::TokenEnd) )
+			{
+				continue;
+			}
+
+			// A lone '/' is a part of the token, e.g. textures/wall
+			if ( nextClass == CharClasses::CommentStart && !IsComment() )
+			{
+				continue;
+			}
+
+			break;
+		}
+
+		const StringView result = view.substr( start, position - start );
 
-	// Escape from a quote
-	if ( inQuote && view[position] == '"' )
-	{
 		if constexpr ( DebugLexer )
 		{
-			printf( "Lexer::Next: found a '\"', toggling quote mode\n" );
+			printf( "Lexer::Scan: token '%.*s'\n", int( result.size() ), result.data() );
 		}
 
-		ToggleQuoteMode();
-		IncrementPosition();
+		kind = TokenKinds::Identifier;
+		scanRestart = restart;
+		return result;
 	}
 
-	return result;
+	if constexpr ( DebugLexer )
+	{
+		printf( "Lexer::Scan: EOF\n" );
+	}
+
+	// Ran out of text in a gap between tokens, which can be thrown away,
+	// or in a comment (NewLine goes past the end) or quote, which can't
+	scanRestart = (position == size && !inQuote) ? size : restart;
+	kind = TokenKinds::EndOfFile;
+	return {};
 }
 
 // ============================
-// Lexer::Expect
+// Lexer::NextView
 // ============================
-bool Lexer::Expect( const char* expectedToken, bool advance )
+StringView Lexer::NextView( bool withDelimiter )
 {
-	size_t oldPosition = position;
-	
-	String nextToken = Next();
-	
-	if ( !advance )
-	{
-		position = oldPosition;
-	}
-
-	return nextToken == expectedToken;
+	TokenKinds::Type kind;
+	return NextView( withDelimiter, false, kind );
 }
 
 // ============================
-// Lexer::IsEndOfFile
+// Lexer::NextView
 // ============================
-bool Lexer::IsEndOfFile() const
+StringView Lexer::NextView( bool withDelimiter, bool withEmptyQuotes, TokenKinds::Type& kind )
 {
-	return position >= buffer.size();
+	if ( lookaheadCount > 0U )
+	{
+		if ( lookaheadWithDelimiter != withDelimiter )
+		{
+			DiscardLookahead();
+		}
+
+		// Peeked tokens include empty quotes
+		while ( lookaheadCount > 0U )
+		{
+			const Token token = PopLookahead();
+			if ( withEmptyQuotes || token.kind != TokenKinds::String || !token.text.empty() )
+			{
+				kind = token.kind;
+				return token.text;
+			}
+		}
+	}
+
+	return Scan( withDelimiter, withEmptyQuotes, kind );
 }
 
 // ============================
-// Lexer::CanAdd
-// 
-// Can the character at the position be added
-// to the resulting token?
+// Lexer::NextToken
 // ============================
-bool Lexer::CanAdd() const
+Token Lexer::NextToken( bool withDelimiter )
 {
-	const char& c = view[position];
+	if ( lookaheadCount > 0U )
+	{
+		if ( lookaheadWithDelimiter == withDelimiter )
+		{
+			return PopLookahead();
+		}
+
+		DiscardLookahead();
+	}
 
-	return CanAdvance() && c != '"';
+	return ScanToken( withDelimiter );
 }
 
 // ============================
-// Lexer::CanAdvance
-// 
-// Can the position move forward?
-// By default, the advancing will stop when a space,
-// tab or EOF is hit. However, if we're in quote mode,
-// we only look for EOF and the ending quotation mark
+// Lexer::Peek
 // ============================
-bool Lexer::CanAdvance() const
+Token Lexer::Peek( size_t n, bool withDelimiter )
 {
-	if ( IsEndOfFile() )
+	if ( n >= MaxLookahead )
 	{
-		return false;
+		return {};
 	}
 
-	const char& c = view[position];
+	if ( lookaheadCount > 0U && lookaheadWithDelimiter != withDelimiter )
+	{
+		DiscardLookahead();
+	}
 
-	if ( inQuote )
+	if ( n < lookaheadCount )
 	{
-		return !IsEndOfFile() && c != '"';
+		return LookaheadAt( n );
 	}
 
-	if ( IsDelimiter() )
+	// Scan from the end of the last peeked token, then go back
+	const size_t oldOffset = windowOffset + position;
+	const bool oldInQuote = inQuote;
+
+	if ( lookaheadCount == 0U )
 	{
-		return false;
+		// Remember the lines up to here, in case the lookahead
+		// gets thrown away and this has to be scanned again
+		UpdateLineInfo( std::min( position, view.size() ) );
+		lookaheadLineNumber = lineNumber;
+		lookaheadLineStart = lineStart;
+		lookaheadWithDelimiter = withDelimiter;
+		// Don't let the peeked text get refilled away
+		pinnedOffset = oldOffset;
+	}
+	else
+	{
+		const LookaheadToken& last = lookahead[(lookaheadHead + lookaheadCount - 1U) % MaxLookahead];
+		position = last.endOffset - windowOffset;
+		inQuote = last.inQuote;
 	}
 
-	return c != ' ' && c != '\t' && c != '\0' && !IsEndOfLine();
+	while ( lookaheadCount <= n )
+	{
+		const Token token = ScanToken( withDelimiter );
+		if ( token.IsEndOfFile() )
+		{
+			break;
+		}
+
+		UpdateLineInfo( position );
+
+		LookaheadToken& entry = lookahead[(lookaheadHead + lookaheadCount) % MaxLookahead];
+		entry.token = token;
+		entry.textOffset = windowOffset + (token.text.data() - view.data());
+		entry.endOffset = windowOffset + position;
+		entry.lineNumber = lineNumber;
+		entry.lineStart = lineStart;
+		entry.inQuote = inQuote;
+		lookaheadCount++;
+	}
+
+	position = oldOffset - windowOffset;
+	inQuote = oldInQuote;
+
+	if ( lookaheadCount == 0U )
+	{
+		pinnedOffset = NoPosition;
+	}
+
+	return n < lookaheadCount ? LookaheadAt( n ) : Token{};
 }
 
 // ============================
-// Lexer::IsComment
-// 
-// Checks if the position is
-// currently on a comment
+// Lexer::ScanToken
 // ============================
-bool Lexer::IsComment() const
+Token Lexer::ScanToken( bool withDelimiter )
 {
-	if ( inQuote )
+	Token token;
+	token.text = Scan( withDelimiter, true, token.kind );
+	if ( token.kind == TokenKinds::EndOfFile )
 	{
-		return false;
+		return token;
+	}
+
+	// Figure out where the token starts, quoted tokens
+	// start at their opening quotation mark
+	size_t start = token.text.data() - view.data();
+	if ( token.kind == TokenKinds::String )
+	{
+		start--;
 	}
+	UpdateLineInfo( start );
+	token.line = lineNumber;
+	token.column = uint32_t( start + windowOffset - lineStart ) + 1U;
 
-	if ( view[position] == '/' )
+	// Quoted numbers are still strings, but numeric ones,
+	// since keyvalues like "health" "100" are quoted too
+	if ( token.kind != TokenKinds::Delimiter )
 	{
-		if ( position + 1 < buffer.size() )
+		token.numeric = ParseNumber( token.text, token.number, token.integer );
+		if ( token.numeric && token.kind == TokenKinds::Identifier )
 		{
-			if ( view[position + 1] == '/' )
-			{
-				return true;
-			}
+			token.kind = TokenKinds::Number;
 		}
 	}
 
-	return false;
-}
+	if ( symbolTable && ShouldIntern( token.kind ) )
+	{
+		token.symbol = symbolTable->Intern( token.text );
+	}
 
-// ============================
-// Lexer::IsEndOfLine
-// ============================
-inline bool Lexer::IsEndOfLine() const
-{
-	return view[position] == '\n' || view[position] == '\r';
+	return token;
 }
 
 // ============================
-// Lexer::IsDelimiter
+// Lexer::PeekView
 // ============================
-inline bool Lexer::IsDelimiter() const
+StringView Lexer::PeekView( bool withDelimiter )
 {
-	return (delimiterString.find( view[position] ) != String::npos) && !inQuote;
+	// Going through the lookahead means the token
+	// won't be scanned again once it's consumed
+	for ( size_t i = 0U; i < MaxLookahead; i++ )
+	{
+		const Token token = Peek( i, withDelimiter );
+		if ( token.kind != TokenKinds::String || !token.text.empty() )
+		{
+			return token.text;
+		}
+	}
+
+	// The lookahead is full of empty quotes, look past them
+	// Positions move around when the window is refilled,
+	// offsets from the start of the input don't
+	const size_t oldOffset = windowOffset + position;
+	const size_t oldPinnedOffset = pinnedOffset;
+	const bool oldInQuote = inQuote;
+
+	pinnedOffset = std::min( pinnedOffset, oldOffset );
+	const StringView result = NextView( withDelimiter );
+	pinnedOffset = oldPinnedOffset;
+
+	position = oldOffset - windowOffset;
+	inQuote = oldInQuote;
+
+	return result;
+}
+
+// ============================
+// Lexer::Expect
+// ============================
+bool Lexer::Expect( const char* expectedToken, bool advance )
+{
+	return Expect( StringView( expectedToken ), advance );
+}
+
+// ============================
+// Lexer::Expect
+// ============================
+bool Lexer::Expect( StringView expectedToken, bool advance )
+{
+	// Compares against what Next would return, glued quote and all,
+	// but without putting the two pieces together in a string
+	TokenKinds::Type kind;
+	if ( advance )
+	{
+		const StringView token = NextView( false, false, kind );
+		if ( !GluesQuote( kind, position, inQuote ) )
+		{
+			return token == expectedToken;
+		}
+
+		// The view may not survive the next scan when streaming
+		const size_t tokenSize = token.size();
+		const bool startMatches = expectedToken.substr( 0U, tokenSize ) == token;
+		const StringView quoted = NextView( false, true, kind );
+		return startMatches && expectedToken.substr( tokenSize ) == quoted;
+	}
+
+	// Peeked tokens include empty quotes, which Next skips
+	size_t index = 0U;
+	Token token = Peek( index );
+	while ( token.kind == TokenKinds::String && token.text.empty() && index + 2U < MaxLookahead )
+	{
+		token = Peek( ++index );
+	}
+
+	if ( token.kind == TokenKinds::String && token.text.empty() )
+	{
+		// Past this many empty quotes, don't bother with gluing
+		return PeekView() == expectedToken;
+	}
+
+	const LookaheadToken& entry = lookahead[(lookaheadHead + index) % MaxLookahead];
+	if ( !GluesQuote( token.kind, entry.endOffset - windowOffset, entry.inQuote ) )
+	{
+		return token.text == expectedToken;
+	}
+
+	// Peeking further may refill the window, so look the token up again
+	const Token quoted = Peek( index + 1U );
+	token = LookaheadAt( index );
+	return expectedToken.size() == token.text.size() + quoted.text.size()
+		&& expectedToken.substr( 0U, token.text.size() ) == token.text
+		&& expectedToken.substr( token.text.size() ) == quoted.text;
+}
+
+// ============================
+// Lexer::IsEndOfFile
+// ============================
+bool Lexer::IsEndOfFile() const
+{
+	return position >= view.size() && !CanRefill();
+}
+
+// ============================
+// Lexer::TokeniseParallel
+// ============================
+Vector<Token> Lexer::TokeniseParallel( bool withDelimiter, size_t numThreads )
+{
+	Vector<Token> tokens;
+	DiscardLookahead();
+
+	const size_t begin = std::min( position, view.size() );
+	const size_t end = view.size();
+
+	if ( numThreads == 0U )
+	{
+		numThreads = std::max( std::thread::hardware_concurrency(), 1U );
+	}
+	numThreads = std::min( numThreads, std::max<size_t>( (end - begin) / ParallelMinBytes, 1U ) );
+
+	// Streaming lexers don't have the whole text to split up
+	if ( reader || numThreads == 1U )
+	{
+		for ( Token token = NextToken( withDelimiter ); !token.IsEndOfFile(); token = NextToken( withDelimiter ) )
+		{
+			tokens.push_back( token );
+		}
+		return tokens;
+	}
+
+	// Evenly spaced split points, moved forward to the next line
+	// Tokens and comments never go past a line break, quotes can
+	Vector<size_t> splits( numThreads + 1U );
+	splits[0] = begin;
+	splits[numThreads] = end;
+	for ( size_t i = 1U; i < numThreads; i++ )
+	{
+		const size_t from = std::max( begin + (end - begin) * i / numThreads, splits[i - 1U] );
+		splits[i] = std::min( FindNewLine( from ) + 1U, end );
+	}
+
+	// Whether a quote is open at the end of each range can only be
+	// known once the previous ranges are done, so work it out for
+	// both cases, and count the lines while at it
+	struct RangeInfo
+	{
+		bool endsInQuote[2];
+		size_t newLines;
+	};
+
+	Vector<RangeInfo> ranges( numThreads );
+	RunParallel( numThreads, [&]( size_t i )
+	{
+		const size_t from = splits[i];
+		const size_t to = splits[i + 1U];
+
+		ranges[i].endsInQuote[0] = EndsInQuote( from, to, false );
+		ranges[i].endsInQuote[1] = i > 0U ? EndsInQuote( from, to, true ) : false;
+		ranges[i].newLines = size_t( std::count( view.data() + from, view.data() + to, '\n' ) );
+	} );
+
+	// Now go through the ranges in order and throw away
+	// the splits that would land inside a quote
+	struct Piece
+	{
+		size_t from;
+		size_t to;
+		uint32_t line;
+		size_t lineStart;
+	};
+
+	UpdateLineInfo( begin );
+
+	Vector<Piece> pieces;
+	pieces.push_back( { begin, end, lineNumber, lineStart } );
+	uint32_t line = lineNumber;
+	bool quoteOpen = false;
+	for ( size_t i = 0U; i < numThreads; i++ )
+	{
+		if ( i > 0U && !quoteOpen )
+		{
+			pieces.push_back( { splits[i], end, line, splits[i] } );
+		}
+
+		quoteOpen = ranges[i].endsInQuote[quoteOpen];
+		line += uint32_t( ranges[i].newLines );
+		pieces.back().to = splits[i + 1U];
+	}
+
+	Vector<Vector<Token>> pieceTokens( pieces.size() );
+	RunParallel( pieces.size(), [&]( size_t i )
+	{
+		const Piece& piece = pieces[i];
+		TokeniseRange( piece.from, piece.to, piece.line, piece.lineStart, withDelimiter, pieceTokens[i] );
+	} );
+
+	size_t numTokens = 0U;
+	for ( const Vector<Token>& piece : pieceTokens )
+	{
+		numTokens += piece.size();
+	}
+
+	tokens.reserve( numTokens );
+	for ( const Vector<Token>& piece : pieceTokens )
+	{
+		tokens.insert( tokens.end(), piece.begin(), piece.end() );
+	}
+
+	// The table isn't thread-safe, so the pieces don't intern anything,
+	// and doing it here in order keeps the IDs the same as NextToken's
+	if ( symbolTable )
+	{
+		for ( Token& token : tokens )
+		{
+			if ( ShouldIntern( token.kind ) )
+			{
+				token.symbol = symbolTable->Intern( token.text );
+			}
+		}
+	}
+
+	position = end;
+	scanRestart = end;
+	inQuote = false;
+
+	return tokens;
+}
+
+// ============================
+// Lexer::IsComment
+// 
+// Checks if the position is
+// currently on a comment
+// ============================
+bool Lexer::IsComment() const
+{
+	if ( inQuote )
+	{
+		return false;
+	}
+
+	if ( CharClassAt( position ) & CharClasses::CommentStart )
+	{
+		if ( position + 1 < view.size() )
+		{
+			if ( view[position + 1] == '/' )
+			{
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+// ============================
+// Lexer::ParseNumber
+// 
+// Parses the whole text as an integer or a
+// floating-point number, fails if there's
+// anything else in it
+// ============================
+bool Lexer::ParseNumber( StringView text, double& outNumber, int64_t& outInteger )
+{
+	if ( text.empty() )
+	{
+		return false;
+	}
+
+	// from_chars doesn't accept a leading '+' but we do
+	const bool hasPlus = text[0] == '+';
+	if ( hasPlus )
+	{
+		text.remove_prefix( 1U );
+	}
+
+	// from_chars accepts "inf" and "nan" but we don't, so
+	// there has to be a digit or '.' right after the sign
+	const size_t digitAt = (!hasPlus && !text.empty() && text[0] == '-') ? 1U : 0U;
+	if ( digitAt >= text.size() )
+	{
+		return false;
+	}
+
+	const char digit = text[digitAt];
+	if ( digit != '.' && (digit < '0' || digit > '9') )
+	{
+		return false;
+	}
+
+	const char* begin = text.data();
+	const char* end = begin + text.size();
+
+	int64_t integer = 0;
+	auto result = std::from_chars( begin, end, integer );
+	if ( result.ec == std::errc() && result.ptr == end )
+	{
+		outInteger = integer;
+		outNumber = double( integer );
+		return true;
+	}
+
+	double number = 0.0;
+	result = std::from_chars( begin, end, number );
+	if ( result.ec != std::errc() || result.ptr != end )
+	{
+		return false;
+	}
+
+	outNumber = number;
+	// Truncate, like atoi would
+	outInteger = std::fabs( number ) < 9.2e18 ? int64_t( number ) : 0;
+	return true;
+}
+
+// ============================
+// Lexer::UpdateLineInfo
+// 
+// Counts the lines up to "target", continuing
+// from where the last count stopped, so the
+// whole text is only counted once
+// ============================
+void Lexer::UpdateLineInfo( size_t target )
+{
+	target += windowOffset;
+
+	// Went backwards, count from the start, unless
+	// the start is gone because we're streaming
+	if ( target < lineCursor )
+	{
+		if ( windowOffset != 0U )
+		{
+			return;
+		}
+
+		lineCursor = 0;
+		lineNumber = 1;
+		lineStart = 0;
+	}
+
+	while ( lineCursor < target )
+	{
+		const size_t newLine = FindNewLine( lineCursor - windowOffset ) + windowOffset;
+		if ( newLine >= target )
+		{
+			break;
+		}
+
+		lineNumber++;
+		lineStart = newLine + 1;
+		lineCursor = newLine + 1;
+	}
+
+	lineCursor = target;
+}
+
+// ============================
+// Lexer::LookaheadAt
+// ============================
+Token Lexer::LookaheadAt( size_t index ) const
+{
+	const LookaheadToken& entry = lookahead[(lookaheadHead + index) % MaxLookahead];
+
+	Token token = entry.token;
+	token.text = StringView( view.data() + (entry.textOffset - windowOffset), token.text.size() );
+	return token;
+}
+
+// ============================
+// Lexer::PopLookahead
+// 
+// Takes the first peeked token and
+// moves the position past it
+// ============================
+Token Lexer::PopLookahead()
+{
+	const Token token = LookaheadAt( 0U );
+	const LookaheadToken& entry = lookahead[lookaheadHead];
+
+	position = entry.endOffset - windowOffset;
+	scanRestart = position;
+	inQuote = entry.inQuote;
+	lookaheadLineNumber = entry.lineNumber;
+	lookaheadLineStart = entry.lineStart;
+
+	lookaheadHead = (lookaheadHead + 1U) % MaxLookahead;
+	lookaheadCount--;
+	pinnedOffset = lookaheadCount > 0U ? entry.endOffset : NoPosition;
+
+	return token;
+}
+
+// ============================
+// Lexer::DiscardLookahead
+// 
+// Forgets the peeked tokens, and the lines
+// that were counted while peeking
+// ============================
+void Lexer::DiscardLookahead()
+{
+	if ( lookaheadCount == 0U )
+	{
+		return;
+	}
+
+	lineCursor = windowOffset + position;
+	lineNumber = lookaheadLineNumber;
+	lineStart = lookaheadLineStart;
+
+	lookaheadHead = 0U;
+	lookaheadCount = 0U;
+	pinnedOffset = NoPosition;
+}
+
+// ============================
+// Lexer::ResetState
+// 
+// Goes back to the start, and forgets
+// about any file or stream it had
+// ============================
+void Lexer::ResetState()
+{
+	position = 0;
+	inQuote = false;
+	scanRestart = 0;
+	quoteOffset = NoPosition;
+	quoteSearched = 0;
+	lineCursor = 0;
+	lineNumber = 1;
+	lineStart = 0;
+
+	reader = nullptr;
+	windowOffset = 0;
+	pinnedOffset = NoPosition;
+	readerFinished = false;
+
+	lookaheadHead = 0;
+	lookaheadCount = 0;
+
+	mappedFile.reset();
+}
+
+// ============================
+// Lexer::LoadStream
+// 
+// Reads the rest of the stream
+// straight into the buffer
+// ============================
+void Lexer::LoadStream( std::istream& stream )
+{
+	ResetState();
+	buffer.clear();
+
+	// If the stream can tell its size, read it all in one go,
+	// otherwise go through the stream buffer
+	const auto start = stream.tellg();
+	if ( start != std::istream::pos_type( -1 ) && stream.seekg( 0, std::ios::end ) )
+	{
+		const auto end = stream.tellg();
+		stream.seekg( start );
+
+		buffer.resize( size_t( end - start ) );
+		stream.read( buffer.data(), std::streamsize( buffer.size() ) );
+		// Text mode may translate line endings, making the text shorter
+		buffer.resize( size_t( stream.gcount() ) );
+	}
+	else
+	{
+		stream.clear();
+		buffer.assign( std::istreambuf_iterator<char>( stream ), std::istreambuf_iterator<char>() );
+	}
+
+	view = buffer;
+}
+
+// ============================
+// Lexer::SkipWhitespace
+// 
+// Finds the first character at or after
+// "from" that isn't a whitespace or newline
+// ============================
+size_t Lexer::SkipWhitespace( size_t from ) const
+{
+	const size_t size = view.size();
+	const char* data = view.data();
+	constexpr uint8_t whitespaceClasses = CharClasses::Whitespace | CharClasses::NewLine;
+
+#if ADM_USE_SSE41
+	while ( from + 16U <= size )
+	{
+		const __m128i chunk = _mm_loadu_si128( reinterpret_cast<const __m128i*>(data + from) );
+		const uint32_t whitespaceMask = MatchBytes( chunk, ' ' ) | MatchBytes( chunk, '\t' )
+			| MatchBytes( chunk, '\n' ) | MatchBytes( chunk, '\r' ) | MatchBytes( chunk, '\0' );
+
+		const uint32_t significantMask = ~whitespaceMask & 0xFFFFU;
+		if ( significantMask )
+		{
+			return from + LowestBitIndex( significantMask );
+		}
+
+		from += 16U;
+	}
+#endif
+
+	while ( from < size && (charClasses[uint8_t( data[from] )] & whitespaceClasses) )
+	{
+		from++;
+	}
+
+	return from;
+}
+
+// ============================
+// Lexer::FindQuote
+// 
+// Finds the first quotation mark at or after
+// "from", or the end of the text
+// ============================
+size_t Lexer::FindQuote( size_t from ) const
+{
+	const size_t size = view.size();
+	const char* data = view.data();
+
+#if ADM_USE_SSE41
+	while ( from + 16U <= size )
+	{
+		const __m128i chunk = _mm_loadu_si128( reinterpret_cast<const __m128i*>(data + from) );
+		const uint32_t quoteMask = MatchBytes( chunk, '"' );
+		if ( quoteMask )
+		{
+			return from + LowestBitIndex( quoteMask );
+		}
+
+		from += 16U;
+	}
+#endif
+
+	while ( from < size && data[from] != '"' )
+	{
+		from++;
+	}
+
+	return from;
+}
+
+// ============================
+// Lexer::FindNewLine
+// 
+// Finds the first '\n' at or after
+// "from", or the end of the text
+// ============================
+size_t Lexer::FindNewLine( size_t from ) const
+{
+	const size_t size = view.size();
+	const char* data = view.data();
+
+#if ADM_USE_SSE41
+	while ( from + 16U <= size )
+	{
+		const __m128i chunk = _mm_loadu_si128( reinterpret_cast<const __m128i*>(data + from) );
+		const uint32_t newLineMask = MatchBytes( chunk, '\n' );
+		if ( newLineMask )
+		{
+			return from + LowestBitIndex( newLineMask );
+		}
+
+		from += 16U;
+	}
+#endif
+
+	while ( from < size && data[from] != '\n' )
+	{
+		from++;
+	}
+
+	return from;
+}
+
+// ============================
+// Lexer::EndsInQuote
+// 
+// Follows quotes and comments through [from, to)
+// the same way the tokeniser does, to find out if
+// a quote is left open at the end
+// ============================
+bool Lexer::EndsInQuote( size_t from, size_t to, bool startInQuote ) const
+{
+	const char* data = view.data();
+	bool quoteOpen = startInQuote;
+
+	while ( from < to )
+	{
+		if ( quoteOpen )
+		{
+			from = FindEither( data, from, to, '"', '"' );
+			if ( from < to )
+			{
+				quoteOpen = false;
+				from++;
+			}
+			continue;
+		}
+
+		from = FindEither( data, from, to, '"', '/' );
+		if ( from >= to )
+		{
+			break;
+		}
+
+		if ( data[from] == '"' )
+		{
+			quoteOpen = true;
+			from++;
+		}
+		// Quotation marks in comments don't count
+		else if ( from + 1U < to && data[from + 1U] == '/' )
+		{
+			from = FindEither( data, from + 2U, to, '\n', '\n' );
+		}
+		else
+		{
+			from++;
+		}
+	}
+
+	return quoteOpen;
+}
+
+// ============================
+// Lexer::TokeniseRange
+// 
+// Tokenises [from, to) with a separate lexer that
+// views the same text, "from" must be between tokens
+// ============================
+void Lexer::TokeniseRange( size_t from, size_t to, uint32_t line, size_t lineStartOffset, bool withDelimiter, Vector<Token>& outTokens ) const
+{
+	Lexer lexer;
+	lexer.view = view.substr( 0U, to );
+	lexer.charClasses = charClasses;
+	lexer.position = from;
+	lexer.scanRestart = from;
+	lexer.lineCursor = from;
+	lexer.lineNumber = line;
+	lexer.lineStart = lineStartOffset;
+
+	for ( Token token = lexer.NextToken( withDelimiter ); !token.IsEndOfFile(); token = lexer.NextToken( withDelimiter ) )
+	{
+		outTokens.push_back( token );
+	}
+}
+
+// ============================
+// Lexer::CanRefill
+// ============================
+bool Lexer::CanRefill() const
+{
+	return reader && !readerFinished;
+}
+
+// ============================
+// Lexer::Refill
+// 
+// Throws away everything in the window before
+// "keepFrom" and reads another chunk after
+// what's left
+// ============================
+void Lexer::Refill( size_t keepFrom )
+{
+	if ( !CanRefill() )
+	{
+		return;
+	}
+
+	// Don't throw away anything that's being peeked at
+	if ( pinnedOffset != NoPosition )
+	{
+		keepFrom = std::min( keepFrom, pinnedOffset - windowOffset );
+	}
+	keepFrom = std::min( { keepFrom, position, buffer.size() } );
+
+	// Lines can't be counted after their text is gone
+	UpdateLineInfo( keepFrom );
+
+	buffer.erase( 0U, keepFrom );
+	windowOffset += keepFrom;
+	position -= keepFrom;
+	scanRestart -= std::min( scanRestart, keepFrom );
+
+	const size_t kept = buffer.size();
+	buffer.resize( kept + chunkSize );
+	const size_t bytesRead = reader( buffer.data() + kept, chunkSize );
+	buffer.resize( kept + bytesRead );
+	view = buffer;
+
+	if ( bytesRead == 0U )
+	{
+		readerFinished = true;
+	}
+
+	if constexpr ( DebugLexer )
+	{
+		printf( "Lexer::Refill: read %zu bytes, window is %zu bytes\n", bytesRead, buffer.size() );
+	}
 }
 
 // ============================
@@ -368,8 +1479,8 @@ inline bool Lexer::IsDelimiter() const
 // ============================
 void Lexer::NewLine()
 {
-	size_t newPosition = view.find( '\n', position+1 );
-	if ( newPosition == String::npos )
+	size_t newPosition = FindNewLine( position + 1 );
+	if ( newPosition >= view.size() )
 	{
 		if constexpr ( DebugLexer )
 		{
@@ -398,17 +1509,3 @@ inline void Lexer::ToggleQuoteMode()
 {
 	inQuote = !inQuote;
 }
-
-// ============================
-// Lexer::IncrementPosition
-// 
-// Safely increments the position
-// in the text buffer
-// ============================
-inline void Lexer::IncrementPosition()
-{
-	if ( !IsEndOfFile() )
-	{
-		position++;
-	}
-}
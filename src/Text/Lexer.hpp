@@ -5,8 +5,55 @@
 
 namespace adm
 {	
+	class MappedFile;
+
 	constexpr bool DebugLexer = false;
-	constexpr size_t NoPosition = ~0U;
+	constexpr size_t NoPosition = ~size_t( 0 );
+
+	struct TokenKinds
+	{
+		enum Type : uint8_t
+		{
+			EndOfFile,
+			// Unquoted text that isn't a number
+			Identifier,
+			// Unquoted number, e.g. 1, -20, 3.5, 1e6
+			Number,
+			// Quoted text, the quotation marks are not included
+			String,
+			// A single delimiter character
+			Delimiter
+		};
+	};
+
+	// ============================
+	// Token
+	// 
+	// A token with everything the lexer found out
+	// about it, so parsers don't have to look again
+	// ============================
+	struct Token
+	{
+		// Points into the lexer's text
+		StringView text{};
+		// Only valid if numeric is true
+		double number{ 0.0 };
+		// Only valid if numeric is true, truncated if the number isn't whole
+		int64_t integer{ 0 };
+		// Where the token starts, both are 1-based
+		uint32_t line{ 0 };
+		uint32_t column{ 0 };
+		TokenKinds::Type kind{ TokenKinds::EndOfFile };
+		// Number tokens, and strings like "100" are numeric
+		bool numeric{ false };
+		// Only set if the lexer has a symbol table, see Lexer::SetSymbolTable
+		SymbolId symbol{ InvalidSymbol };
+
+		bool IsEndOfFile() const
+		{
+			return kind == TokenKinds::EndOfFile;
+		}
+	};
 	
 	// ============================
 	// Lexer
@@ -20,6 +67,21 @@ namespace adm
 	// token = lex.Next(); // buncha
 	// token = lex.Next(); // text
 	// token = lex.Next(); // here
+	// 
+	// A quotation mark right after a token doesn't end it in
+	// Next, the quoted text is glued onto it and the closing
+	// one ends it, so abc"def ghi"x is abcdef ghi and x
+	// 
+	// NextView does the same without allocating, the
+	// returned view points into the lexer's buffer and
+	// is valid for as long as the lexer's text is
+	// It can't glue two pieces of the buffer together, so
+	// for NextView and NextToken a quotation mark always
+	// ends the token before it: abc, def ghi and x
+	// 
+	// Lexers made with FromStream/FromDescriptor/FromReader
+	// only keep a few chunks of the input in memory, and
+	// their views are only valid until the next call
 	// ============================
 	class Lexer final
 	{
@@ -31,6 +93,17 @@ namespace adm
 	
 		static constexpr const char* DelimitersDefault = DelimitersSimple;
 
+		// How much is read at once when streaming
+		static constexpr size_t DefaultChunkSize = 64U * 1024U;
+		// TokeniseParallel won't give a thread less text than this
+		static constexpr size_t ParallelMinBytes = 256U * 1024U;
+		// How far ahead Peek can look
+		static constexpr size_t MaxLookahead = 8U;
+
+		// Reads up to maxBytes into destination
+		// @returns How many bytes were read, 0 if there's nothing left
+		using ReadFn = size_t( char* destination, size_t maxBytes );
+
 	public:
 		Lexer();
 		Lexer( Lexer&& other ) noexcept;
@@ -43,6 +116,19 @@ namespace adm
 		Lexer( StringView text );
 		~Lexer();
 
+		// Memory-maps a file and tokenises directly over the mapping,
+		// without copying the text anywhere
+		// @returns Nothing if the file could not be opened
+		static Optional<Lexer> FromFile( StringView filePath );
+		// Streams the text in chunks, refilling as tokens are consumed,
+		// for inputs that are too large to keep in memory
+		// The stream must outlive the lexer
+		static Lexer	FromStream( std::istream& stream, size_t chunkSize = DefaultChunkSize );
+		// Streams the text in chunks from a file descriptor, see FromStream
+		static Lexer	FromDescriptor( int fileDescriptor, size_t chunkSize = DefaultChunkSize );
+		// Streams the text in chunks from a custom source, see FromStream
+		static Lexer	FromReader( std::function<ReadFn> reader, size_t chunkSize = DefaultChunkSize );
+
 		// Wipes the buffer
 		void			Clear();
 		// Loads the lexer with text
@@ -52,33 +138,158 @@ namespace adm
 		// Delimiters are individual characters that can separate tokens,
 		// they are tokens themselves. Default is Lexer::DelimitersSimple
 		void			SetDelimiters( const char* delimiters );
+		// Identifier tokens get interned into the table, and get their
+		// Token::symbol set. Quoted strings too, if internStrings is true,
+		// though that's only worth it when they repeat a lot, e.g. keys
+		// The table can be shared between lexers, pass nullptr to stop
+		void			SetSymbolTable( SharedPtr<SymbolTable> table, bool internStrings = false );
+		const SharedPtr<SymbolTable>& GetSymbolTable() const;
 
 		// Gets the next token and advances
 		std::string		Next( bool withDelimiter = false );
+		// Gets the next token as a view into the buffer and advances
+		// Quoted tokens are returned without their quotation marks
+		StringView		NextView( bool withDelimiter = false );
+		// Gets the next token as a view into the buffer, without advancing
+		StringView		PeekView( bool withDelimiter = false );
+		// Gets the next token along with its kind, location and numeric value
+		// Unlike the other two, this one also returns empty quoted strings
+		Token			NextToken( bool withDelimiter = false );
+		// Gets the token n places ahead without advancing, Peek( 0 ) is
+		// the one NextToken would return, n must be below MaxLookahead
+		// Peeked tokens are kept until they're consumed, so looking
+		// ahead several times doesn't scan anything twice
+		Token			Peek( size_t n = 0U, bool withDelimiter = false );
 		// Compares the next token to expectedToken, optionally
 		// advancing the position in the buffer
 		bool			Expect( const char* expectedToken, bool advance = false );
+		// Compares the next token to expectedToken, optionally
+		// advancing the position in the buffer
+		bool			Expect( StringView expectedToken, bool advance = false );
 		// @returns Whether EOF has been reached or not
+		// When streaming, this is only known once everything has been read
 		bool			IsEndOfFile() const;
 
+		// Tokenises everything from the current position to the end,
+		// splitting the text at line breaks that aren't inside quotes
+		// and tokenising the pieces on separate threads
+		// 0 threads means one per hardware thread, streaming lexers only use one
+		// @returns The same tokens NextToken would give, in the same order
+		Vector<Token>	TokeniseParallel( bool withDelimiter = false, size_t numThreads = 0 );
+
 	private:
-		bool			CanAdd() const;
-		bool			CanAdvance() const;
-		
+		// Character classes, a character can belong to multiple
+		struct CharClasses
+		{
+			enum Type : uint8_t
+			{
+				Whitespace = 1 << 0,
+				NewLine = 1 << 1,
+				Delimiter = 1 << 2,
+				Quote = 1 << 3,
+				CommentStart = 1 << 4,
+
+				// Anything that can end an ordinary token
+				TokenEnd = Whitespace | NewLine | Delimiter | Quote | CommentStart
+			};
+		};
+
+		using CharClassTable = Array<uint8_t, 256>;
+		static CharClassTable BuildCharClasses( const char* delimiters );
+
+		inline uint8_t	CharClassAt( size_t at ) const
+		{
+			return charClasses[uint8_t( view[at] )];
+		}
+
+		// NextView, but also tells the kind and can return empty quotes
+		StringView		NextView( bool withDelimiter, bool withEmptyQuotes, TokenKinds::Type& kind );
+		// Whether Next glues the quoted text at the given place
+		// onto the token of this kind that ended there
+		bool			GluesQuote( TokenKinds::Type kind, size_t at, bool atInQuote ) const;
+		StringView		Scan( bool withDelimiter, bool withEmptyQuotes, TokenKinds::Type& kind );
+		StringView		ScanWindow( bool withDelimiter, bool withEmptyQuotes, TokenKinds::Type& kind );
+		Token			ScanToken( bool withDelimiter );
+		static bool		ParseNumber( StringView text, double& outNumber, int64_t& outInteger );
+		inline bool		ShouldIntern( TokenKinds::Type kind ) const
+		{
+			return kind == TokenKinds::Identifier || (internStrings && kind == TokenKinds::String);
+		}
+		void			UpdateLineInfo( size_t target );
+
 		bool			IsComment() const;
-		inline bool		IsEndOfLine() const;
-		inline bool		IsDelimiter() const;
 
+		// These scan 16 characters at a time when SSE is available
+		size_t			SkipWhitespace( size_t from ) const;
+		size_t			FindQuote( size_t from ) const;
+		size_t			FindNewLine( size_t from ) const;
+		bool			EndsInQuote( size_t from, size_t to, bool startInQuote ) const;
+		void			TokeniseRange( size_t from, size_t to, uint32_t line, size_t lineStartOffset, bool withDelimiter, Vector<Token>& outTokens ) const;
+
+		// A token scanned ahead by Peek, with offsets from the
+		// start of the input, since the window can move
+		struct LookaheadToken
+		{
+			Token			token;
+			size_t			textOffset;
+			size_t			endOffset;
+			// Line info and quote mode at endOffset
+			uint32_t		lineNumber;
+			size_t			lineStart;
+			bool			inQuote;
+		};
+
+		Token			LookaheadAt( size_t index ) const;
+		Token			PopLookahead();
+		void			DiscardLookahead();
+
+		void			ResetState();
+		void			LoadStream( std::istream& stream );
+		bool			CanRefill() const;
+		void			Refill( size_t keepFrom );
 		void			NewLine();
 		inline void		ToggleQuoteMode();
-		inline void		IncrementPosition();
 
 	private:
 		size_t			position{ 0 }; // position in the buffer
 		bool			inQuote{ false };
+		// Where the scan can be restarted from, if the window runs out mid-token
+		size_t			scanRestart{ 0 };
+		// If the window ran out inside a quote, the offset of its opening quotation
+		// mark, and how far it was searched without finding the closing one
+		// Both are from the start of the input, the search resumes from there
+		size_t			quoteOffset{ NoPosition };
+		size_t			quoteSearched{ 0 };
+
+		// Lines are counted lazily, up to the last token from NextToken
+		// The cursor and line start are offsets from the start of the input
+		size_t			lineCursor{ 0 };
+		uint32_t		lineNumber{ 1 };
+		size_t			lineStart{ 0 };
+
+		// When streaming, the buffer is a window into the input
+		std::function<ReadFn> reader;
+		size_t			chunkSize{ DefaultChunkSize };
+		size_t			windowOffset{ 0 }; // offset of the window from the start of the input
+		size_t			pinnedOffset{ NoPosition }; // refills won't discard anything after this
+		bool			readerFinished{ false };
+
+		// Tokens scanned ahead by Peek, the position stays before them
+		Array<LookaheadToken, MaxLookahead> lookahead{};
+		size_t			lookaheadHead{ 0 };
+		size_t			lookaheadCount{ 0 };
+		bool			lookaheadWithDelimiter{ false };
+		// Line info at the position, for when the lookahead is thrown away
+		uint32_t		lookaheadLineNumber{ 1 };
+		size_t			lookaheadLineStart{ 0 };
 
 		String			buffer;
-		StringView		view;
+		StringView		view; // either views the buffer or the mapped file
+		SharedPtr<MappedFile> mappedFile;
 		String			delimiterString{ DelimitersDefault };
+		CharClassTable	charClasses{ BuildCharClasses( DelimitersDefault ) };
+
+		SharedPtr<SymbolTable> symbolTable;
+		bool			internStrings{ false };
 	};
 }
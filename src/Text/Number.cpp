@@ -0,0 +1,209 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#include "Precompiled.hpp"
+using namespace adm;
+
+// ============================
+// SkipSpaces
+// ============================
+static const char* SkipSpaces( const char* begin, const char* end )
+{
+	while ( begin != end && (*begin == ' ' || (*begin >= '\t' && *begin <= '\r')) )
+	{
+		begin++;
+	}
+
+	return begin;
+}
+
+// ============================
+// SkipPlus
+// 
+// from_chars doesn't accept a leading '+' but atof does
+// ============================
+static const char* SkipPlus( const char* begin, const char* end )
+{
+	if ( end - begin > 1 && begin[0] == '+' && begin[1] != '-' )
+	{
+		begin++;
+	}
+
+	return begin;
+}
+
+// ============================
+// FloatFromChars
+// 
+// std::from_chars, but with atof's results where they differ:
+// hex floats are read with their 0x prefix, and numbers out of
+// float's range become infinity or zero instead of nothing
+// @returns Past the number, or nullptr if there is none
+// ============================
+static const char* FloatFromChars( const char* begin, const char* end, float& outValue )
+{
+	begin = SkipPlus( begin, end );
+
+	// from_chars wants hex floats without their sign and prefix
+	const bool negative = begin != end && *begin == '-';
+	const char* digits = negative ? begin + 1 : begin;
+	const bool hex = end - digits > 2 && digits[0] == '0' && (digits[1] == 'x' || digits[1] == 'X')
+		&& (std::isxdigit( static_cast<unsigned char>( digits[2] ) ) || digits[2] == '.');
+
+	const char* first = hex ? digits + 2 : begin;
+	const auto format = hex ? std::chars_format::hex : std::chars_format::general;
+	const float sign = hex && negative ? -1.0f : 1.0f;
+
+	float value = 0.0f;
+	const auto result = std::from_chars( first, end, value, format );
+	if ( result.ec == std::errc::invalid_argument )
+	{
+		// Something like "0x." is just a 0 followed by garbage
+		return hex ? FloatFromChars( begin, digits + 1, outValue ) : nullptr;
+	}
+
+	if ( result.ec == std::errc::result_out_of_range )
+	{
+		// atof goes through double, which covers most of these
+		double wide = 0.0;
+		if ( std::from_chars( first, end, wide, format ).ec == std::errc() )
+		{
+			value = std::abs( wide ) > FLT_MAX
+				? std::copysign( INFINITY, float( wide ) ) : float( wide );
+		}
+		else
+		{
+			// Too big or too small even for a double, the exponent's sign tells which,
+			// or without one, whether there are any digits other than 0 before the point
+			const char exponent = hex ? 'p' : 'e';
+			const char* exponentChar = std::find_if( first, result.ptr, [exponent]( char c )
+			{
+				return std::tolower( static_cast<unsigned char>( c ) ) == exponent;
+			} );
+
+			bool tiny = false;
+			if ( exponentChar != result.ptr )
+			{
+				tiny = exponentChar[1] == '-';
+			}
+			else
+			{
+				const char* digit = std::find_if( first, result.ptr, []( char c ) { return c != '0' && c != '-'; } );
+				tiny = digit == result.ptr || *digit == '.';
+			}
+
+			value = tiny ? 0.0f : INFINITY;
+			value = *first == '-' ? -value : value;
+		}
+	}
+
+	outValue = sign * value;
+	return result.ptr;
+}
+
+// ============================
+// adm::WriteFloat
+// ============================
+size_t adm::WriteFloat( float value, char* buffer, size_t bufferSize )
+{
+	const auto result = std::to_chars( buffer, buffer + bufferSize, value );
+	return result.ec == std::errc() ? size_t( result.ptr - buffer ) : 0U;
+}
+
+// ============================
+// adm::WriteInteger
+// ============================
+size_t adm::WriteInteger( int value, char* buffer, size_t bufferSize )
+{
+	const auto result = std::to_chars( buffer, buffer + bufferSize, value );
+	return result.ec == std::errc() ? size_t( result.ptr - buffer ) : 0U;
+}
+
+// ============================
+// adm::WriteFloats
+// ============================
+size_t adm::WriteFloats( const float* values, size_t count, char* buffer, size_t bufferSize )
+{
+	char* position = buffer;
+	char* const end = buffer + bufferSize;
+
+	for ( size_t i = 0U; i < count; i++ )
+	{
+		if ( i > 0U )
+		{
+			if ( position == end )
+			{
+				return 0U;
+			}
+
+			*position++ = ' ';
+		}
+
+		const auto result = std::to_chars( position, end, values[i] );
+		if ( result.ec != std::errc() )
+		{
+			return 0U;
+		}
+
+		position = result.ptr;
+	}
+
+	return size_t( position - buffer );
+}
+
+// ============================
+// adm::ParseFloat
+// ============================
+float adm::ParseFloat( StringView text )
+{
+	const char* end = text.data() + text.size();
+	float value = 0.0f;
+	FloatFromChars( SkipSpaces( text.data(), end ), end, value );
+	return value;
+}
+
+// ============================
+// adm::ParseInteger
+// ============================
+int adm::ParseInteger( StringView text )
+{
+	const char* end = text.data() + text.size();
+	const char* begin = SkipPlus( SkipSpaces( text.data(), end ), end );
+
+	int value = 0;
+	if ( std::from_chars( begin, end, value ).ec == std::errc::result_out_of_range )
+	{
+		// Clamped like strtol does, rather than left at 0
+		value = *begin == '-' ? INT_MIN : INT_MAX;
+	}
+
+	return value;
+}
+
+// ============================
+// adm::ParseFloats
+// ============================
+size_t adm::ParseFloats( StringView text, float* outValues, size_t count )
+{
+	const char* position = text.data();
+	const char* end = position + text.size();
+
+	for ( size_t i = 0U; i < count; i++ )
+	{
+		position = SkipSpaces( position, end );
+		if ( i > 0U && position != end && *position == ',' )
+		{
+			position = SkipSpaces( position + 1, end );
+		}
+
+		const char* next = FloatFromChars( position, end, outValues[i] );
+		if ( nullptr == next )
+		{
+			return i;
+		}
+
+		position = next;
+	}
+
+	return count;
+}
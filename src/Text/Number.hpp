@@ -0,0 +1,48 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+namespace adm
+{
+	// ============================
+	// Number conversions
+	//
+	// Writes numbers as the shortest text that reads back as
+	// the exact same value, into the caller's buffer, without
+	// allocating or going through the C locale
+	// Usage:
+	//
+	// char buffer[FloatTextSize];
+	// size_t length = WriteFloat( 0.1f, buffer, sizeof( buffer ) ); // "0.1"
+	// ParseFloat( StringView( buffer, length ) ) == 0.1f; // true
+	//
+	// Nothing is NUL-terminated, so leave room for one if needed
+	// ============================
+
+	// Longest text a float or int can be written as, e.g. "-1.1754944e-38"
+	constexpr size_t FloatTextSize = 16U;
+	constexpr size_t IntegerTextSize = 12U;
+	// Floats separated by spaces, for 2, 3 and 4-component vectors
+	constexpr size_t Vec2TextSize = FloatTextSize * 2U;
+	constexpr size_t Vec3TextSize = FloatTextSize * 3U;
+	constexpr size_t Vec4TextSize = FloatTextSize * 4U;
+
+	// @returns How many characters were written, 0 if the buffer is too small
+	size_t		WriteFloat( float value, char* buffer, size_t bufferSize );
+	size_t		WriteInteger( int value, char* buffer, size_t bufferSize );
+	// Writes the values separated by spaces, e.g. "1 0.5 -2"
+	// @returns How many characters were written, 0 if the buffer is too small
+	size_t		WriteFloats( const float* values, size_t count, char* buffer, size_t bufferSize );
+
+	// Like atof and atoi, leading whitespace is skipped and parsing
+	// stops at the first character that doesn't belong to the number
+	// Hex floats, inf and nan are read as well, floats out of range become
+	// infinity or 0 and ints are clamped to INT_MIN and INT_MAX, like strtol
+	// @returns The number, or 0 if the text doesn't start with one
+	float		ParseFloat( StringView text );
+	int			ParseInteger( StringView text );
+	// Parses numbers separated by whitespace or commas, e.g. "1 0.5 -2"
+	// @returns How many values were parsed, the rest are left as they were
+	size_t		ParseFloats( StringView text, float* outValues, size_t count );
+}
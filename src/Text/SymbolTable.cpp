@@ -0,0 +1,184 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#include "Precompiled.hpp"
+using namespace adm;
+
+// Names are copied into blocks of at least this many bytes
+constexpr size_t NameBlockSize = 16U * 1024U;
+constexpr size_t MinimumSlots = 64U;
+
+// ============================
+// SymbolTable::Intern
+// ============================
+SymbolId SymbolTable::Intern( StringView text )
+{
+	return Intern( text, Hash( text ) );
+}
+
+// ============================
+// SymbolTable::Intern
+// ============================
+SymbolId SymbolTable::Intern( StringView text, uint32_t hash )
+{
+	if ( slots.empty() )
+	{
+		Grow();
+	}
+
+	size_t slot = FindSlot( text, hash );
+	if ( slots[slot] != 0U )
+	{
+		return slots[slot] - 1U;
+	}
+
+	// Keep the table at most 3/4 full, so probes stay short
+	if ( (symbols.size() + 1U) * 4U > slots.size() * 3U )
+	{
+		Grow();
+		slot = FindSlot( text, hash );
+	}
+
+	const SymbolId id = SymbolId( symbols.size() );
+	symbols.push_back( { StoreName( text ), hash } );
+	slots[slot] = id + 1U;
+
+	return id;
+}
+
+// ============================
+// SymbolTable::Find
+// ============================
+SymbolId SymbolTable::Find( StringView text ) const
+{
+	if ( slots.empty() )
+	{
+		return InvalidSymbol;
+	}
+
+	const size_t slot = FindSlot( text, Hash( text ) );
+	return slots[slot] != 0U ? slots[slot] - 1U : InvalidSymbol;
+}
+
+// ============================
+// SymbolTable::GetName
+// ============================
+StringView SymbolTable::GetName( SymbolId id ) const
+{
+	return id < symbols.size() ? symbols[id].name : StringView();
+}
+
+// ============================
+// SymbolTable::GetHash
+// ============================
+uint32_t SymbolTable::GetHash( SymbolId id ) const
+{
+	return id < symbols.size() ? symbols[id].hash : Hash( StringView() );
+}
+
+// ============================
+// SymbolTable::GetCount
+// ============================
+size_t SymbolTable::GetCount() const
+{
+	return symbols.size();
+}
+
+// ============================
+// SymbolTable::Clear
+// ============================
+void SymbolTable::Clear()
+{
+	symbols.clear();
+	slots.clear();
+	nameBlocks.clear();
+	blockUsed = 0U;
+	blockSize = 0U;
+}
+
+// ============================
+// SymbolTable::Hash
+// ============================
+uint32_t SymbolTable::Hash( StringView text )
+{
+	uint32_t hash = 2166136261U;
+	for ( const char c : text )
+	{
+		hash ^= uint8_t( c );
+		hash *= 16777619U;
+	}
+
+	return hash;
+}
+
+// ============================
+// SymbolTable::FindSlot
+//
+// Finds the slot the string is in, or the
+// empty slot it would go into
+// ============================
+size_t SymbolTable::FindSlot( StringView text, uint32_t hash ) const
+{
+	const size_t mask = slots.size() - 1U;
+	size_t slot = hash & mask;
+
+	while ( slots[slot] != 0U )
+	{
+		const Symbol& symbol = symbols[slots[slot] - 1U];
+		if ( symbol.hash == hash && symbol.name == text )
+		{
+			break;
+		}
+
+		slot = (slot + 1U) & mask;
+	}
+
+	return slot;
+}
+
+// ============================
+// SymbolTable::StoreName
+// ============================
+StringView SymbolTable::StoreName( StringView text )
+{
+	if ( text.empty() )
+	{
+		return {};
+	}
+
+	if ( blockUsed + text.size() > blockSize )
+	{
+		blockSize = std::max( NameBlockSize, text.size() );
+		blockUsed = 0U;
+		nameBlocks.push_back( std::make_unique<char[]>( blockSize ) );
+	}
+
+	char* name = nameBlocks.back().get() + blockUsed;
+	std::memcpy( name, text.data(), text.size() );
+	blockUsed += text.size();
+
+	return StringView( name, text.size() );
+}
+
+// ============================
+// SymbolTable::Grow
+//
+// Doubles the slots, the hashes are kept
+// around so nothing is hashed again
+// ============================
+void SymbolTable::Grow()
+{
+	slots.assign( std::max( MinimumSlots, slots.size() * 2U ), 0U );
+
+	const size_t mask = slots.size() - 1U;
+	for ( size_t id = 0U; id < symbols.size(); id++ )
+	{
+		size_t slot = symbols[id].hash & mask;
+		while ( slots[slot] != 0U )
+		{
+			slot = (slot + 1U) & mask;
+		}
+
+		slots[slot] = uint32_t( id + 1U );
+	}
+}
@@ -0,0 +1,76 @@
+// SPDX-FileCopyrightText: 2022 Admer Šuko
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+namespace adm
+{
+	using SymbolId = uint32_t;
+	constexpr SymbolId InvalidSymbol = ~SymbolId( 0 );
+
+	// ============================
+	// SymbolTable
+	//
+	// Interns strings, giving each distinct one a stable
+	// 32-bit ID, so they can be compared and used as map
+	// keys without touching the characters again
+	// Usage:
+	//
+	// SymbolTable symbols;
+	// SymbolId origin = symbols.Intern( "origin" );
+	// symbols.Intern( "origin" ) == origin; // true
+	// symbols.GetName( origin ); // "origin"
+	//
+	// IDs start at 0 and go up in the order strings were first
+	// interned, names stay valid for as long as the table does
+	// ============================
+	class SymbolTable final
+	{
+	public:
+		SymbolTable() = default;
+		SymbolTable( SymbolTable&& table ) = default;
+		SymbolTable( const SymbolTable& table ) = delete;
+		~SymbolTable() = default;
+
+		// Gets the ID of the string, adding it if it isn't there yet
+		SymbolId		Intern( StringView text );
+		// Same as above, with the hash already worked out
+		SymbolId		Intern( StringView text, uint32_t hash );
+		// @returns The ID of the string, or InvalidSymbol if it was never interned
+		SymbolId		Find( StringView text ) const;
+
+		// @returns The interned string, or an empty one for invalid IDs
+		StringView		GetName( SymbolId id ) const;
+		// @returns The hash of the interned string, see Hash
+		uint32_t		GetHash( SymbolId id ) const;
+		// @returns How many distinct strings there are
+		size_t			GetCount() const;
+
+		// Wipes all symbols, invalidating their IDs and names
+		void			Clear();
+
+		// FNV-1a, it's what every symbol's hash is computed with
+		static uint32_t Hash( StringView text );
+
+	private:
+		struct Symbol
+		{
+			StringView		name;
+			uint32_t		hash;
+		};
+
+		size_t			FindSlot( StringView text, uint32_t hash ) const;
+		StringView		StoreName( StringView text );
+		void			Grow();
+
+	private:
+		Vector<Symbol>	symbols;
+		// Open addressing, each slot is an ID + 1, 0 means empty
+		Vector<uint32_t> slots;
+		// Names are copied into blocks that never move,
+		// so views of them stay valid as the table grows
+		Vector<UniquePtr<char[]>> nameBlocks;
+		size_t			blockUsed{ 0 };
+		size_t			blockSize{ 0 };
+	};
+}
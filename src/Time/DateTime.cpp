@@ -16,8 +16,8 @@ inline DateTime FromYMDandHMS( const date::year_month_day& ymd, const date::hh_m
 {
 	return DateTime::FromFullDate(
 		int( ymd.year() ),
-		unsigned int( ymd.month() ),
-		unsigned int( ymd.day() ),
+		int( unsigned( ymd.month() ) ),
+		int( unsigned( ymd.day() ) ),
 		hms.hours().count(),
 		hms.minutes().count(),
 		hms.seconds().count() );